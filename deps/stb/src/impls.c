@@ -3,9 +3,15 @@
  * for using them with precompiled modules
  */
 
+/* Must precede stb_truetype, which otherwise defines its own fallback packer */
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb_rect_pack.h>
+
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb_truetype.h>
 
+/* The failure reason is a plain global, racy with images decoded on several threads */
+#define STBI_NO_FAILURE_STRINGS
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
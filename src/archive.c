@@ -0,0 +1,305 @@
+#include "archive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+
+/* Shortest match worth a sequence, the offset alone takes two bytes */
+#define LZ_MIN_MATCH 4
+/* Matches reach back at most this far, offsets are stored in two bytes */
+#define LZ_MAX_OFFSET 65535
+/* Size of the match finder's table of recent positions */
+#define LZ_HASH_BITS 16
+
+struct archive
+{
+    struct asset_view view;
+    const struct archive_header* header;
+    const struct archive_entry* entries;
+    const unsigned int* buckets;
+    const char* names;
+};
+
+/* =------------------------------------------------------------------------= */
+unsigned long long hash_archive_path(const char* path)
+{
+    return hash_bytes(HASH_SEED, path, strlen(path));
+}
+
+int normalize_archive_path(const char* path, char* buf, size_t sz)
+{
+    while (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+        path += 2;
+    size_t len = strlen(path);
+    if (len >= sz)
+        return 0;
+    for (size_t i = 0; i <= len; ++i)
+        buf[i] = path[i] == '\\' ? '/' : path[i];
+    return 1;
+}
+
+/* Index of the bucket holding the given hash */
+static unsigned int bucket_of(const struct archive_header* hdr, unsigned long long hash)
+{
+    return (unsigned int)(hash >> (64 - hdr->bucket_bits));
+}
+
+/* =------------------------------------------------------------------------= */
+/* Checks that every offset of the table of contents stays within the archive */
+static int validate_archive(archive_t ar)
+{
+    const struct archive_header* hdr = ar->header;
+    size_t size = ar->view.size;
+    if (hdr->magic != ARCHIVE_MAGIC || hdr->version != ARCHIVE_VERSION)
+        return 0;
+    if (hdr->bucket_bits < 1 || hdr->bucket_bits > 24 || hdr->toc_offset % sizeof(unsigned long long) != 0)
+        return 0;
+
+    /* Table of contents, checked piecewise so that the sums cannot overflow */
+    size_t num_buckets = (size_t) 1 << hdr->bucket_bits;
+    if (hdr->toc_offset < sizeof(*hdr) || hdr->toc_offset > size)
+        return 0;
+    size_t left = size - (size_t) hdr->toc_offset;
+    if (hdr->num_entries > left / sizeof(struct archive_entry))
+        return 0;
+    left -= hdr->num_entries * sizeof(struct archive_entry);
+    if (num_buckets + 1 > left / sizeof(unsigned int))
+        return 0;
+    left -= (num_buckets + 1) * sizeof(unsigned int);
+    if (hdr->names_size > left)
+        return 0;
+
+    const unsigned char* base = ar->view.data;
+    ar->entries = (const struct archive_entry*)(base + hdr->toc_offset);
+    ar->buckets = (const unsigned int*)(ar->entries + hdr->num_entries);
+    ar->names = (const char*)(ar->buckets + num_buckets + 1);
+
+    if (ar->buckets[0] != 0 || ar->buckets[num_buckets] != hdr->num_entries)
+        return 0;
+    for (size_t b = 0; b < num_buckets; ++b)
+        if (ar->buckets[b] > ar->buckets[b + 1])
+            return 0;
+
+    for (unsigned int i = 0; i < hdr->num_entries; ++i)
+    {
+        const struct archive_entry* e = ar->entries + i;
+        if (e->offset < sizeof(*hdr) || e->offset % ARCHIVE_ALIGNMENT != 0
+         || e->offset > hdr->toc_offset || e->size > hdr->toc_offset - e->offset)
+            return 0;
+        if (e->compression == ARCHIVE_STORED ? e->size != e->raw_size : e->compression != ARCHIVE_LZ)
+            return 0;
+        if (e->name_length >= ARCHIVE_MAX_PATH || e->name_offset > hdr->names_size
+         || e->name_length > hdr->names_size - e->name_offset)
+            return 0;
+
+        /* Lookups rely on the hash and its bucket */
+        unsigned int b = bucket_of(hdr, e->hash);
+        if (e->hash != hash_bytes(HASH_SEED, ar->names + e->name_offset, e->name_length)
+         || i < ar->buckets[b] || i >= ar->buckets[b + 1])
+            return 0;
+    }
+    return 1;
+}
+
+archive_t open_archive(const char* filename)
+{
+    archive_t ar = calloc(1, sizeof(struct archive));
+    if (!open_asset(filename, ASSET_ACCESS_NORMAL, &ar->view))
+    {
+        free(ar);
+        return 0;
+    }
+    ar->header = (const struct archive_header*) ar->view.data;
+    if (ar->view.size < sizeof(struct archive_header) || !validate_archive(ar))
+    {
+        fprintf(stderr, "Could not open archive %s: not a valid archive\n", filename);
+        close_archive(ar);
+        return 0;
+    }
+    return ar;
+}
+
+void close_archive(archive_t ar)
+{
+    close_asset(&ar->view);
+    free(ar);
+}
+
+const struct archive_entry* find_archive_entry(archive_t ar, const char* path)
+{
+    char name[ARCHIVE_MAX_PATH];
+    if (!normalize_archive_path(path, name, sizeof(name)))
+        return 0;
+    size_t len = strlen(name);
+    unsigned long long hash = hash_bytes(HASH_SEED, name, len);
+
+    /* Entries are sorted by hash, a bucket's entries end where the next bucket's begin */
+    unsigned int b = bucket_of(ar->header, hash);
+    for (unsigned int i = ar->buckets[b]; i < ar->buckets[b + 1]; ++i)
+    {
+        const struct archive_entry* e = ar->entries + i;
+        if (e->hash == hash && e->name_length == len && memcmp(ar->names + e->name_offset, name, len) == 0)
+            return e;
+    }
+    return 0;
+}
+
+int read_archive_entry(archive_t ar, const struct archive_entry* entry, struct asset_view* view)
+{
+    const unsigned char* blob = ar->view.data + entry->offset;
+    if (entry->compression == ARCHIVE_STORED)
+    {
+        view->data = blob;
+        view->size = (size_t) entry->size;
+        view->storage = ASSET_STORAGE_NONE;
+        return 1;
+    }
+
+    unsigned char* data = malloc(entry->raw_size ? (size_t) entry->raw_size : 1);
+    if (!decompress_lz(blob, (size_t) entry->size, data, (size_t) entry->raw_size))
+    {
+        fprintf(stderr, "Could not decompress archive entry %.*s\n",
+                (int) entry->name_length, ar->names + entry->name_offset);
+        free(data);
+        return 0;
+    }
+    view->data = data;
+    view->size = (size_t) entry->raw_size;
+    view->storage = ASSET_STORAGE_HEAP;
+    return 1;
+}
+
+/* =------------------------------------------------------------------------= */
+/*
+  Compressed data is a series of sequences, each a token byte holding the
+  literal count in its high nibble and the match length minus LZ_MIN_MATCH
+  in its low one, the literals, then the two byte little endian match
+  offset. Nibbles of 15 continue in extra bytes, added up until one is
+  below 255. The last sequence ends after its literals
+ */
+size_t max_compressed_size(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+/* Writes the continuation bytes of a length */
+static unsigned char* put_length(unsigned char* out, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *out++ = 255;
+    *out++ = (unsigned char) len;
+    return out;
+}
+
+/* Writes a sequence, a zero match length ends the stream */
+static unsigned char* put_sequence(unsigned char* out, const unsigned char* lit, size_t lit_len, size_t match_len, size_t offset)
+{
+    unsigned char* token = out++;
+    *token = (unsigned char)((lit_len >= 15 ? 15 : lit_len) << 4);
+    if (lit_len >= 15)
+        out = put_length(out, lit_len - 15);
+    memcpy(out, lit, lit_len);
+    out += lit_len;
+    if (match_len)
+    {
+        *out++ = (unsigned char)(offset & 0xFF);
+        *out++ = (unsigned char)(offset >> 8);
+        size_t m = match_len - LZ_MIN_MATCH;
+        *token |= (unsigned char)(m >= 15 ? 15 : m);
+        if (m >= 15)
+            out = put_length(out, m - 15);
+    }
+    return out;
+}
+
+/* Reads the continuation bytes of a length, returns zero past the end of the input */
+static int get_length(const unsigned char** ip, const unsigned char* end, size_t* len)
+{
+    unsigned char b;
+    do
+    {
+        if (*ip == end)
+            return 0;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 1;
+}
+
+size_t compress_lz(const unsigned char* src, size_t size, unsigned char* dst)
+{
+    /* Last position plus one of every hashed four byte prefix, greedy matching */
+    size_t* table = calloc((size_t) 1 << LZ_HASH_BITS, sizeof(size_t));
+    unsigned char* out = dst;
+    size_t anchor = 0, i = 0;
+    while (i + LZ_MIN_MATCH <= size)
+    {
+        unsigned int v;
+        memcpy(&v, src + i, sizeof(v));
+        unsigned int h = (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t cand = table[h];
+        table[h] = i + 1;
+        if (!cand || i - (cand - 1) > LZ_MAX_OFFSET || memcmp(src + cand - 1, src + i, LZ_MIN_MATCH) != 0)
+        {
+            ++i;
+            continue;
+        }
+
+        size_t match = cand - 1, len = LZ_MIN_MATCH;
+        while (i + len < size && src[match + len] == src[i + len])
+            ++len;
+        out = put_sequence(out, src + anchor, i - anchor, len, i - match);
+        i += len;
+        anchor = i;
+    }
+    out = put_sequence(out, src + anchor, size - anchor, 0, 0);
+    free(table);
+    return (size_t)(out - dst);
+}
+
+int decompress_lz(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size)
+{
+    const unsigned char* ip = src;
+    const unsigned char* in_end = src + src_size;
+    unsigned char* op = dst;
+    unsigned char* out_end = dst + dst_size;
+    while (ip < in_end)
+    {
+        unsigned int token = *ip++;
+
+        /* Literals */
+        size_t lit = token >> 4;
+        if (lit == 15 && !get_length(&ip, in_end, &lit))
+            return 0;
+        if (lit > (size_t)(in_end - ip) || lit > (size_t)(out_end - op))
+            return 0;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == in_end)
+            break;
+
+        /* Match */
+        if (in_end - ip < 2)
+            return 0;
+        size_t offset = ip[0] | ((size_t) ip[1] << 8);
+        ip += 2;
+        size_t len = token & 15;
+        if (len == 15 && !get_length(&ip, in_end, &len))
+            return 0;
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - dst) || len > (size_t)(out_end - op))
+            return 0;
+        const unsigned char* m = op - offset;
+        if (offset >= len)
+            memcpy(op, m, len);
+        else
+        {
+            /* Overlapping matches repeat the last offset bytes */
+            for (size_t k = 0; k < len; ++k)
+                op[k] = m[k];
+        }
+        op += len;
+    }
+    return op == out_end;
+}
@@ -0,0 +1,122 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _ARCHIVE_H_
+#define _ARCHIVE_H_
+
+#include <stddef.h>
+#include "assetload.h"
+
+/*
+  Archive layout, all integers in host byte order:
+    header
+    blobs, each starting at a 16 byte aligned offset
+    table of contents at toc_offset:
+      entries, sorted by path hash
+      bucket table, num_buckets + 1 entry indices
+      path names, not null terminated
+  Buckets are indexed by the top bucket_bits of the path hash and hold the
+  index of their first entry, so that a lookup only compares the entries
+  between two consecutive buckets
+ */
+#define ARCHIVE_MAGIC     0x4B505653u /* "SVPK" */
+#define ARCHIVE_VERSION   1u
+#define ARCHIVE_ALIGNMENT 16
+/* Longest path an entry may have */
+#define ARCHIVE_MAX_PATH  1024
+
+/* How an entry's blob is stored */
+enum archive_compression
+{
+    ARCHIVE_STORED = 0,  /* Raw file contents */
+    ARCHIVE_LZ           /* Compressed with compress_lz */
+};
+
+struct archive_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int num_entries;
+    unsigned int bucket_bits;           /* Log2 of the bucket count, at least one */
+    unsigned long long toc_offset;
+    unsigned long long names_size;
+};
+
+struct archive_entry
+{
+    unsigned long long hash;            /* hash_archive_path of the path */
+    unsigned long long offset;          /* Blob offset from the start of the archive */
+    unsigned long long size;            /* Blob size */
+    unsigned long long raw_size;        /* Size of the file the blob holds */
+    unsigned int name_offset;           /* Path offset in the name table */
+    unsigned int name_length;
+    unsigned int compression;           /* An archive_compression */
+    unsigned int reserved;
+};
+
+/* Opaque datatype of an opened archive */
+typedef struct archive* archive_t;
+
+/*
+  Rewrites a path to the form archives store, forward slashes without
+  leading ./ components. Returns zero if it does not fit the buffer
+ */
+int normalize_archive_path(const char* path, char* buf, size_t sz);
+/* Hashes a normalized path */
+unsigned long long hash_archive_path(const char* path);
+
+/*
+  Maps an archive and validates its table of contents, so that
+  lookups need no further checks. Returns null and reports the
+  reason on stderr on failure
+ */
+archive_t open_archive(const char* filename);
+/* Unmaps an archive, views into it must be closed already */
+void close_archive(archive_t ar);
+/* Looks up the entry of the given path, null if missing. Expected constant time */
+const struct archive_entry* find_archive_entry(archive_t ar, const char* path);
+/*
+  Opens a view of an entry's contents. Stored entries are viewed in place,
+  compressed ones are decompressed into a copy owned by the view.
+  Returns zero if a compressed blob is corrupt
+ */
+int read_archive_entry(archive_t ar, const struct archive_entry* entry, struct asset_view* view);
+
+/* Worst case size of compress_lz's output for the given input size */
+size_t max_compressed_size(size_t size);
+/*
+  Compresses a buffer with a byte oriented LZ77 scheme that decodes quickly,
+  dst must hold max_compressed_size bytes. Returns the compressed size
+ */
+size_t compress_lz(const unsigned char* src, size_t size, unsigned char* dst);
+/* Decompresses a compress_lz buffer, returns zero unless it decodes to exactly dst_size bytes */
+int decompress_lz(const unsigned char* src, size_t src_size, unsigned char* dst, size_t dst_size);
+
+#endif // ! _ARCHIVE_H_
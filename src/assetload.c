@@ -1,40 +1,344 @@
 #include "assetload.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+#include "archive.h"
 
-long int get_filesize(const char* fn)
-{
-    /* Filesize in bytes */
-    long int size = -1;
+/* Maximum number of mounted archives */
+#define MAX_MOUNTED_ARCHIVES 8
+/*
+  Files below this size are read into the heap instead of being mapped,
+  copying a few pages costs less than setting up a mapping
+ */
+#define MAP_MIN_SIZE (64 * 1024)
 
-    /* Try open the file */
-    FILE* f = 0;
-    f = fopen(fn, "rb");
-    if (!f)
-        return -1;
+/* Environment variable overriding the directory of the on disk caches */
+#define CACHE_DIR_ENV "SHADERVIEW_CACHE_DIR"
+/* Cache directory used when neither the environment nor the caller give one */
+#define DEFAULT_CACHE_DIR ".shaderview_cache"
 
-    /* Seek to its end */
-    fseek(f, 0, SEEK_END);
+/* Shared by the views of empty files, which cannot be mapped */
+static const unsigned char empty_asset[1] = { 0 };
 
-    /* Tell the size of the current pos */
-    size = ftell(f);
+/* Mounted archives, searched last to first */
+static archive_t mounted[MAX_MOUNTED_ARCHIVES];
+static unsigned int num_mounted;
 
-    /* Close the file handle and return size */
-    fclose(f);
-    return size;
+#ifdef _WIN32
+static void report_asset_error(const char* filename, const char* what)
+{
+    fprintf(stderr, "Could not %s %s: error %lu\n", what, filename, (unsigned long) GetLastError());
+}
+#else
+static void report_asset_error(const char* filename, const char* what)
+{
+    fprintf(stderr, "Could not %s %s: %s\n", what, filename, strerror(errno));
+}
+#endif
+
+/* Looks a file missing on disk up in the archives. Returns zero if none has it, negative if it is corrupt */
+static int open_archived_asset(const char* filename, struct asset_view* view)
+{
+    for (unsigned int i = num_mounted; i-- > 0;)
+    {
+        const struct archive_entry* entry = find_archive_entry(mounted[i], filename);
+        if (entry)
+            return read_archive_entry(mounted[i], entry, view) ? 1 : -1;
+    }
+    return 0;
 }
 
-int read_file_to_mem(const char* filename, unsigned char* buf, long buf_sz)
+/*
+  Whether a file is read into the heap instead of mapped. Mapped pages are
+  read when touched, so a file truncated meanwhile, e.g. by an editor saving
+  a watched shader, faults the reader. Sequential readers only go over the
+  data once and get a copy that cannot change under them
+ */
+static int read_into_heap(size_t size, enum asset_access access)
 {
-    /* Try open the file */
-    FILE* f = 0;
-    f = fopen(filename, "rb");
-    if (!f)
+    return access == ASSET_ACCESS_SEQUENTIAL || size < MAP_MIN_SIZE;
+}
+
+int open_asset(const char* filename, enum asset_access access, struct asset_view* view)
+{
+    view->data = 0;
+    view->size = 0;
+    view->storage = ASSET_STORAGE_NONE;
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (access == ASSET_ACCESS_SEQUENTIAL)
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    else if (access == ASSET_ACCESS_RANDOM)
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, flags, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        DWORD err = GetLastError();
+        int found = err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND ? open_archived_asset(filename, view) : 0;
+        if (found)
+            return found > 0;
+        SetLastError(err);
+        report_asset_error(filename, "open");
+        return 0;
+    }
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file, &sz))
+    {
+        report_asset_error(filename, "stat");
+        CloseHandle(file);
+        return 0;
+    }
+    if (sz.QuadPart == 0)
+    {
+        CloseHandle(file);
+        view->data = empty_asset;
+        return 1;
+    }
+    if (read_into_heap((size_t) sz.QuadPart, access))
+    {
+        /* Files may shrink while being read, the view holds what was read */
+        unsigned char* buf = malloc((size_t) sz.QuadPart);
+        size_t total = 0;
+        DWORD got = 1;
+        while (total < (size_t) sz.QuadPart && got > 0)
+        {
+            size_t left = (size_t) sz.QuadPart - total;
+            if (!ReadFile(file, buf + total, left > 0x40000000 ? 0x40000000 : (DWORD) left, &got, 0))
+            {
+                report_asset_error(filename, "read");
+                CloseHandle(file);
+                free(buf);
+                return 0;
+            }
+            total += got;
+        }
+        CloseHandle(file);
+        view->data = buf;
+        view->size = total;
+        view->storage = ASSET_STORAGE_HEAP;
+        return 1;
+    }
+    /* The view keeps the mapping alive after its handle is closed */
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(file);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (!data)
+        report_asset_error(filename, "map");
+    if (mapping)
+        CloseHandle(mapping);
+    if (!data)
+        return 0;
+    view->data = data;
+    view->size = (size_t) sz.QuadPart;
+    view->storage = ASSET_STORAGE_MAPPED;
+    return 1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        int err = errno;
+        int found = err == ENOENT ? open_archived_asset(filename, view) : 0;
+        if (found)
+            return found > 0;
+        errno = err;
+        report_asset_error(filename, "open");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        report_asset_error(filename, "stat");
+        close(fd);
         return 0;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        view->data = empty_asset;
+        return 1;
+    }
+    if (read_into_heap((size_t) st.st_size, access))
+    {
+        /* Files may shrink while being read, the view holds what was read */
+        unsigned char* buf = malloc((size_t) st.st_size);
+        size_t total = 0;
+        while (total < (size_t) st.st_size)
+        {
+            ssize_t got = read(fd, buf + total, (size_t) st.st_size - total);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+            {
+                report_asset_error(filename, "read");
+                close(fd);
+                free(buf);
+                return 0;
+            }
+            if (got == 0)
+                break;
+            total += (size_t) got;
+        }
+        close(fd);
+        view->data = buf;
+        view->size = total;
+        view->storage = ASSET_STORAGE_HEAP;
+        return 1;
+    }
+    /* The mapping stays valid after the descriptor is closed */
+    void* data = mmap(0, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        report_asset_error(filename, "map");
+        close(fd);
+        return 0;
+    }
+    close(fd);
 
-    /* Read the file in single IO operation */
-    fread(buf, 1, buf_sz, f);
+    /* Random readers get no readahead at all, sequential ones are read instead */
+    if (access == ASSET_ACCESS_RANDOM)
+        madvise(data, (size_t) st.st_size, MADV_RANDOM);
+    view->data = data;
+    view->size = (size_t) st.st_size;
+    view->storage = ASSET_STORAGE_MAPPED;
+    return 1;
+#endif
+}
 
-    /* Close the file handle and return success code */
-    fclose(f);
+void close_asset(struct asset_view* view)
+{
+    switch (view->storage)
+    {
+        case ASSET_STORAGE_MAPPED:
+#ifdef _WIN32
+            UnmapViewOfFile((void*) view->data);
+#else
+            munmap((void*) view->data, view->size);
+#endif
+            break;
+        case ASSET_STORAGE_HEAP:
+            free((void*) view->data);
+            break;
+        case ASSET_STORAGE_NONE:
+            break;
+    }
+    view->data = 0;
+    view->size = 0;
+    view->storage = ASSET_STORAGE_NONE;
+}
+
+int mount_archive(const char* filename)
+{
+    if (num_mounted == MAX_MOUNTED_ARCHIVES)
+    {
+        fprintf(stderr, "Could not mount %s, all %u archive mounts are in use\n", filename, MAX_MOUNTED_ARCHIVES);
+        return 0;
+    }
+    archive_t ar = open_archive(filename);
+    if (!ar)
+        return 0;
+    mounted[num_mounted++] = ar;
     return 1;
 }
+
+void unmount_archives()
+{
+    while (num_mounted > 0)
+        close_archive(mounted[--num_mounted]);
+}
+
+void* map_file(const char* filename, size_t* size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+    /* The view keeps the mapping alive after its handle is closed */
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_WRITECOPY, 0, 0, 0);
+    CloseHandle(file);
+    if (!mapping)
+        return 0;
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view)
+        return 0;
+    *size = (size_t) sz.QuadPart;
+    return view;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    /* The mapping stays valid after the descriptor is closed */
+    void* view = mmap(0, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return 0;
+    *size = (size_t) st.st_size;
+    return view;
+#endif
+}
+
+void unmap_file(void* view, size_t size)
+{
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+unsigned long long get_file_mtime(const char* filename)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attrs))
+        return 0;
+    return ((unsigned long long) attrs.ftLastWriteTime.dwHighDateTime << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return 0;
+    /* Seconds alone would miss edits made within the same second */
+    return (unsigned long long) st.st_mtim.tv_sec * 1000000000ULL + (unsigned long long) st.st_mtim.tv_nsec;
+#endif
+}
+
+const char* get_cache_dir(const char* dir)
+{
+    const char* env_dir = getenv(CACHE_DIR_ENV);
+    if (env_dir && *env_dir)
+        return env_dir;
+    return dir ? dir : DEFAULT_CACHE_DIR;
+}
+
+void make_dir(const char* path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
@@ -31,10 +31,77 @@
 #ifndef _ASSETLOAD_H_
 #define _ASSETLOAD_H_
 
-/* Retrieves file size in bytes */
-long int get_filesize(const char* fn);
+#include <stddef.h>
 
-/* Reads file to preallocated buffer */
-int read_file_to_mem(const char* filename, unsigned char* buf, long buf_sz);
+/* Expected access pattern of an asset view, tunes the kernel's readahead */
+enum asset_access
+{
+    ASSET_ACCESS_NORMAL,
+    ASSET_ACCESS_SEQUENTIAL,    /* Read front to back once, e.g. parsed text. Always read into the heap */
+    ASSET_ACCESS_RANDOM         /* Scattered lookups, e.g. font tables */
+};
+
+/* What close_asset releases */
+enum asset_storage
+{
+    ASSET_STORAGE_NONE,         /* Empty files and stored archive entries, owned by something else */
+    ASSET_STORAGE_MAPPED,       /* The view's own file mapping */
+    ASSET_STORAGE_HEAP          /* Heap copy, e.g. a small file or a decompressed archive entry */
+};
+
+/* Read only view of a whole file */
+struct asset_view
+{
+    const unsigned char* data;  /* Never null for an open view, even for empty files */
+    size_t size;
+    enum asset_storage storage;
+};
+
+/*
+  Opens a whole file read only. Large files that are not read sequentially
+  are mapped: pages are read in when first touched and shared with the page
+  cache, so the view costs no heap copy. Small files and sequential readers
+  get a heap copy instead, which cannot fault when the file is truncated
+  while open. Either way the view may be referenced for as long as it stays
+  open. Files missing on disk are looked up in the mounted archives. Returns
+  zero and reports the reason on stderr on failure
+ */
+int open_asset(const char* filename, enum asset_access access, struct asset_view* view);
+/* Releases a view returned by open_asset */
+void close_asset(struct asset_view* view);
+
+/*
+  Mounts a packed archive, see archive.h. open_asset serves files from it
+  that are missing on disk, so loose files override archived ones. Later
+  mounts are searched first. Mounting is not thread safe, so mount before
+  assets get loaded from other threads. Returns zero on failure
+ */
+int mount_archive(const char* filename);
+/* Unmounts every archive, views into them must be closed already */
+void unmount_archives();
+
+/*
+  Maps a whole file into memory, copy on write, so the view may be
+  modified without affecting the file. Pages are read in when first
+  touched. Returns null for missing or empty files
+ */
+void* map_file(const char* filename, size_t* size);
+/* Releases a view returned by map_file */
+void unmap_file(void* view, size_t size);
+
+/*
+  Retrieves the last modification time of a file at the finest resolution
+  the platform keeps, in unspecified units. Returns zero for missing files
+ */
+unsigned long long get_file_mtime(const char* filename);
+
+/*
+  Resolves the directory the program and font caches are kept in: the
+  SHADERVIEW_CACHE_DIR environment variable, else the given directory, else
+  .shaderview_cache. The directory may not exist yet
+ */
+const char* get_cache_dir(const char* dir);
+/* Creates a directory, existing ones are left alone */
+void make_dir(const char* path);
 
 #endif // ! _ASSETLOAD_H_
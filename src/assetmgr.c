@@ -0,0 +1,470 @@
+#include "assetmgr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stb_image.h>
+#include <stb_truetype.h>
+#include "assetload.h"
+#include "thread.h"
+#include "hash.h"
+
+/* Environment variable overriding the number of worker threads */
+#define ASSET_THREADS_ENV "SHADERVIEW_ASSET_THREADS"
+/* Upper bound of the default pool size, loads are mostly bound by storage and memory */
+#define DEFAULT_MAX_THREADS 4
+/* Upper bound of the pool size */
+#define MAX_ASSET_THREADS 64
+
+/*
+  Asset handles hold the slot index in the low bits and the slot's generation
+  above it, the same scheme as font handles
+ */
+#define ASSET_INDEX_BITS 16
+#define ASSET_INDEX_MASK ((1u << ASSET_INDEX_BITS) - 1)
+#define ASSET_MAX_SLOTS  (1u << ASSET_INDEX_BITS)
+#define ASSET_NO_SLOT    0xFFFFFFFFu
+
+/* stb_vorbis is built as its own unit without a header */
+extern int stb_vorbis_decode_memory(const unsigned char* mem, int len, int* channels, int* sample_rate, short** output);
+
+/*
+  A single load, shared by every request for the same file version. Entries
+  are allocated one by one, so that workers may keep pointers to them while
+  the slot array grows
+ */
+struct asset_entry
+{
+    /* Immutable after the request */
+    char* path;
+    unsigned long long path_hash;
+    unsigned long long mtime;      /* Modification time when requested, part of the cache key */
+    enum asset_type type;
+
+    /* Written by the loading worker, read by the main thread once collected */
+    struct asset_data data;
+    struct asset_view view;        /* Kept open for raw and font assets */
+    int loaded;
+
+    /* Main thread only, besides orphaned which workers read under the lock */
+    enum asset_state state;
+    unsigned int refs;
+    int orphaned;                  /* Released before its load was collected */
+    struct asset_entry* next;      /* Link of the job or the completion queue */
+};
+
+/* Slot holding a live entry, or a link of the free list */
+struct asset_slot
+{
+    struct asset_entry* entry;
+    unsigned int generation;       /* Bumped on release, so that old handles stop matching */
+    unsigned int next_free;        /* Next free slot while unused */
+    int used;
+};
+
+struct asset_manager
+{
+    /* Cache of live assets, main thread only */
+    struct asset_slot* slots;
+    unsigned int num_slots;        /* Slots ever used */
+    unsigned int slot_cap;
+    unsigned int free_slot;        /* Head of the free list, ASSET_NO_SLOT when empty */
+
+    /* Worker pool */
+    thread_t* workers;
+    unsigned int num_workers;
+    mutex_t lock;
+    condvar_t cv;
+    condvar_t done_cv;             /* Signaled when a load joins the completion queue */
+    int quit;
+    struct asset_entry* jobs;      /* Queued loads, oldest first */
+    struct asset_entry* jobs_tail;
+    struct asset_entry* done;      /* Finished loads awaiting poll_assets */
+};
+
+/* =------------------------------------------------------------------------= */
+/* Releases an entry and whatever it loaded */
+static void destroy_entry(struct asset_entry* e)
+{
+    if (e->loaded)
+    {
+        switch (e->type)
+        {
+            case ASSET_RAW:
+            case ASSET_FONT:
+                close_asset(&e->view);
+                break;
+            case ASSET_TEXT:
+                free((void*) e->data.bytes);
+                break;
+            case ASSET_IMAGE:
+                stbi_image_free(e->data.pixels);
+                break;
+            case ASSET_SOUND:
+                free(e->data.samples);
+                break;
+        }
+    }
+    free(e->path);
+    free(e);
+}
+
+/* Reads and decodes an entry's file on a worker thread, returns zero on failure */
+static int load_entry(struct asset_entry* e)
+{
+    struct asset_data* d = &e->data;
+    d->type = e->type;
+
+    /* Decoded types only need the file until they are decoded */
+    enum asset_access access = e->type == ASSET_RAW ? ASSET_ACCESS_NORMAL
+                             : e->type == ASSET_FONT ? ASSET_ACCESS_RANDOM
+                             : ASSET_ACCESS_SEQUENTIAL;
+    struct asset_view view;
+    if (!open_asset(e->path, access, &view))
+        return 0;
+
+    int ok = 1;
+    switch (e->type)
+    {
+        case ASSET_RAW:
+            e->view = view;
+            d->bytes = view.data;
+            d->size = view.size;
+            return 1;
+        case ASSET_FONT:
+        {
+            /* Catch files that are no fonts here, instead of when they get baked */
+            stbtt_fontinfo info;
+            int offset = view.size >= 12 ? stbtt_GetFontOffsetForIndex(view.data, 0) : -1;
+            if (offset < 0 || !stbtt_InitFont(&info, view.data, offset))
+            {
+                fprintf(stderr, "Could not parse font data %s\n", e->path);
+                close_asset(&view);
+                return 0;
+            }
+            e->view = view;
+            d->bytes = view.data;
+            d->size = view.size;
+            return 1;
+        }
+        case ASSET_TEXT:
+        {
+            char* text = malloc(view.size + 1);
+            memcpy(text, view.data, view.size);
+            text[view.size] = '\0';
+            d->bytes = (const unsigned char*) text;
+            d->size = view.size;
+            break;
+        }
+        case ASSET_IMAGE:
+        {
+            int comp;
+            d->pixels = view.size <= INT_MAX
+                ? stbi_load_from_memory(view.data, (int) view.size, &d->width, &d->height, &comp, 4) : 0;
+            if (!d->pixels)
+            {
+                fprintf(stderr, "Could not decode image %s\n", e->path);
+                ok = 0;
+            }
+            break;
+        }
+        case ASSET_SOUND:
+        {
+            int frames = view.size <= INT_MAX
+                ? stb_vorbis_decode_memory(view.data, (int) view.size, &d->channels, &d->sample_rate, &d->samples) : -1;
+            if (frames < 0)
+            {
+                fprintf(stderr, "Could not decode sound %s\n", e->path);
+                d->samples = 0;
+                ok = 0;
+            }
+            else
+                d->num_frames = (size_t) frames;
+            break;
+        }
+    }
+    close_asset(&view);
+    return ok;
+}
+
+/* Worker thread loop, loading queued entries in request order */
+static void asset_worker(void* arg)
+{
+    asset_manager_t am = arg;
+    mutex_lock(am->lock);
+    for (;;)
+    {
+        while (!am->jobs && !am->quit)
+            condvar_wait(am->cv, am->lock);
+        if (am->quit)
+            break;
+
+        /* Take the oldest job, loads released while queued are skipped */
+        struct asset_entry* e = am->jobs;
+        am->jobs = e->next;
+        if (!am->jobs)
+            am->jobs_tail = 0;
+        int skip = e->orphaned;
+        mutex_unlock(am->lock);
+
+        if (!skip)
+            e->loaded = load_entry(e);
+
+        /* Hand it to the main thread */
+        mutex_lock(am->lock);
+        e->next = am->done;
+        am->done = e;
+        condvar_signal(am->done_cv);
+    }
+    mutex_unlock(am->lock);
+}
+
+/* Number of workers to start, from the environment or the processor count */
+static unsigned int pool_size()
+{
+    const char* forced = getenv(ASSET_THREADS_ENV);
+    if (forced && *forced)
+    {
+        int n = atoi(forced);
+        if (n >= 1 && n <= MAX_ASSET_THREADS)
+            return (unsigned int) n;
+        fprintf(stderr, "Ignoring malformed %s=%s\n", ASSET_THREADS_ENV, forced);
+    }
+
+    /* Leave a processor to the render thread */
+    int n = cpu_count() - 1;
+    if (n < 1)
+        n = 1;
+    if (n > DEFAULT_MAX_THREADS)
+        n = DEFAULT_MAX_THREADS;
+    return (unsigned int) n;
+}
+
+/* =------------------------------------------------------------------------= */
+asset_manager_t init_asset_manager()
+{
+    asset_manager_t am = calloc(1, sizeof(struct asset_manager));
+    am->free_slot = ASSET_NO_SLOT;
+    am->lock = mutex_create();
+    am->cv = condvar_create();
+    am->done_cv = condvar_create();
+
+    unsigned int n = pool_size();
+    am->workers = calloc(n, sizeof(thread_t));
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        thread_t t = thread_create(asset_worker, am);
+        if (t)
+            am->workers[am->num_workers++] = t;
+    }
+    if (am->num_workers == 0)
+        fprintf(stderr, "Could not start asset loader threads, requests will never complete\n");
+    return am;
+}
+
+void free_asset_manager(asset_manager_t am)
+{
+    /* Workers finish their current load and leave the rest queued */
+    mutex_lock(am->lock);
+    am->quit = 1;
+    condvar_broadcast(am->cv);
+    mutex_unlock(am->lock);
+    for (unsigned int i = 0; i < am->num_workers; ++i)
+        thread_join(am->workers[i]);
+    free(am->workers);
+
+    /* Orphans are only referenced by the queues, everything else by its slot */
+    struct asset_entry* queues[2] = { am->jobs, am->done };
+    for (int q = 0; q < 2; ++q)
+    {
+        for (struct asset_entry* e = queues[q]; e;)
+        {
+            struct asset_entry* next = e->next;
+            if (e->orphaned)
+                destroy_entry(e);
+            e = next;
+        }
+    }
+    for (unsigned int i = 0; i < am->num_slots; ++i)
+        if (am->slots[i].used)
+            destroy_entry(am->slots[i].entry);
+    free(am->slots);
+
+    condvar_destroy(am->cv);
+    condvar_destroy(am->done_cv);
+    mutex_destroy(am->lock);
+    free(am);
+}
+
+/* =------------------------------------------------------------------------= */
+/* Resolves a handle to its entry, null for released handles */
+static struct asset_entry* get_entry(asset_manager_t am, asset_t handle)
+{
+    unsigned int index = handle & ASSET_INDEX_MASK;
+    if (index >= am->num_slots)
+        return 0;
+    struct asset_slot* slot = am->slots + index;
+    if (!slot->used || slot->generation != handle >> ASSET_INDEX_BITS)
+        return 0;
+    return slot->entry;
+}
+
+static asset_t slot_handle(asset_manager_t am, unsigned int index)
+{
+    return (am->slots[index].generation << ASSET_INDEX_BITS) | index;
+}
+
+/* Takes a slot off the free list, or a fresh one. Returns ASSET_NO_SLOT when every index is taken */
+static unsigned int acquire_slot(asset_manager_t am)
+{
+    unsigned int index = am->free_slot;
+    if (index != ASSET_NO_SLOT)
+    {
+        am->free_slot = am->slots[index].next_free;
+        return index;
+    }
+    if (am->num_slots == ASSET_MAX_SLOTS)
+        return ASSET_NO_SLOT;
+
+    if (am->num_slots == am->slot_cap)
+    {
+        am->slot_cap = am->slot_cap ? am->slot_cap * 2 : 16;
+        am->slots = realloc(am->slots, am->slot_cap * sizeof(struct asset_slot));
+    }
+    index = am->num_slots++;
+    memset(am->slots + index, 0, sizeof(struct asset_slot));
+    am->slots[index].generation = 1;
+    return index;
+}
+
+/* Puts a slot back on the free list, invalidating the handles given out for it */
+static void free_slot(asset_manager_t am, unsigned int index)
+{
+    struct asset_slot* slot = am->slots + index;
+    slot->used = 0;
+    slot->entry = 0;
+    slot->generation = (slot->generation + 1) & (0xFFFFFFFFu >> ASSET_INDEX_BITS);
+    if (slot->generation == 0)
+        slot->generation = 1;
+    slot->next_free = am->free_slot;
+    am->free_slot = index;
+}
+
+asset_t request_asset(asset_manager_t am, const char* path, enum asset_type type)
+{
+    unsigned long long mtime = get_file_mtime(path);
+    unsigned long long path_hash = hash_bytes(HASH_SEED, path, strlen(path));
+
+    /* Share a live load of the same file version, failed ones are retried instead */
+    for (unsigned int i = 0; i < am->num_slots; ++i)
+    {
+        struct asset_slot* slot = am->slots + i;
+        if (!slot->used)
+            continue;
+        struct asset_entry* e = slot->entry;
+        if (e->path_hash == path_hash && e->type == type && e->mtime == mtime
+         && e->state != ASSET_FAILED && strcmp(e->path, path) == 0)
+        {
+            e->refs++;
+            return slot_handle(am, i);
+        }
+    }
+
+    unsigned int index = acquire_slot(am);
+    if (index == ASSET_NO_SLOT)
+    {
+        fprintf(stderr, "Could not request %s, all %u asset slots are in use\n", path, ASSET_MAX_SLOTS);
+        return 0;
+    }
+    struct asset_entry* e = calloc(1, sizeof(struct asset_entry));
+    e->path = malloc(strlen(path) + 1);
+    strcpy(e->path, path);
+    e->path_hash = path_hash;
+    e->mtime = mtime;
+    e->data.mtime = mtime;
+    e->type = type;
+    e->state = ASSET_PENDING;
+    e->refs = 1;
+    am->slots[index].entry = e;
+    am->slots[index].used = 1;
+
+    /* Queue it */
+    mutex_lock(am->lock);
+    if (am->jobs_tail)
+        am->jobs_tail->next = e;
+    else
+        am->jobs = e;
+    am->jobs_tail = e;
+    condvar_signal(am->cv);
+    mutex_unlock(am->lock);
+    return slot_handle(am, index);
+}
+
+void release_asset(asset_manager_t am, asset_t asset)
+{
+    struct asset_entry* e = get_entry(am, asset);
+    if (!e || --e->refs > 0)
+        return;
+    free_slot(am, asset & ASSET_INDEX_MASK);
+
+    /* Loads in flight are freed once they come out of the completion queue */
+    if (e->state == ASSET_PENDING)
+    {
+        mutex_lock(am->lock);
+        e->orphaned = 1;
+        mutex_unlock(am->lock);
+    }
+    else
+        destroy_entry(e);
+}
+
+unsigned int poll_assets(asset_manager_t am)
+{
+    mutex_lock(am->lock);
+    struct asset_entry* done = am->done;
+    am->done = 0;
+    mutex_unlock(am->lock);
+
+    unsigned int count = 0;
+    while (done)
+    {
+        struct asset_entry* e = done;
+        done = e->next;
+        e->next = 0;
+        if (e->orphaned)
+        {
+            destroy_entry(e);
+            continue;
+        }
+        e->state = e->loaded ? ASSET_READY : ASSET_FAILED;
+        count++;
+    }
+    return count;
+}
+
+enum asset_state wait_asset(asset_manager_t am, asset_t asset)
+{
+    for (;;)
+    {
+        poll_assets(am);
+        enum asset_state state = get_asset_state(am, asset);
+        if (state != ASSET_PENDING || am->num_workers == 0)
+            return state;
+        mutex_lock(am->lock);
+        while (!am->done)
+            condvar_wait(am->done_cv, am->lock);
+        mutex_unlock(am->lock);
+    }
+}
+
+enum asset_state get_asset_state(asset_manager_t am, asset_t asset)
+{
+    struct asset_entry* e = get_entry(am, asset);
+    return e ? e->state : ASSET_FAILED;
+}
+
+const struct asset_data* get_asset_data(asset_manager_t am, asset_t asset)
+{
+    struct asset_entry* e = get_entry(am, asset);
+    return e && e->state == ASSET_READY ? &e->data : 0;
+}
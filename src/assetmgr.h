@@ -0,0 +1,114 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _ASSETMGR_H_
+#define _ASSETMGR_H_
+
+#include <stddef.h>
+
+/* Opaque datatype that loads assets on worker threads */
+typedef struct asset_manager* asset_manager_t;
+/*
+  Handle of a requested asset, zero is never a valid one. Requests sharing
+  a load get the same handle, and released handles stop resolving
+ */
+typedef unsigned int asset_t;
+
+/* How a requested file is decoded */
+enum asset_type
+{
+    ASSET_RAW = 0, /* File contents, mapped when large */
+    ASSET_TEXT,    /* Null terminated copy of the file */
+    ASSET_IMAGE,   /* RGBA8 pixels decoded with stb_image */
+    ASSET_FONT,    /* TrueType data, mapped when large, checked with stb_truetype, ready for load_font */
+    ASSET_SOUND    /* Interleaved 16 bit samples decoded from Ogg Vorbis */
+};
+
+/* Load state of a requested asset */
+enum asset_state
+{
+    ASSET_PENDING = 0, /* Queued or loading, or finished but not yet collected by poll_assets */
+    ASSET_READY,       /* Loaded, data available */
+    ASSET_FAILED       /* Missing or undecodable, reason already printed */
+};
+
+/* Loaded contents of an asset, the fields used depend on its type */
+struct asset_data
+{
+    enum asset_type type;
+    /* Raw, text and font assets */
+    const unsigned char* bytes;   /* Text is null terminated, the terminator is not counted in size */
+    size_t size;
+    /* Image assets, rows top down without padding */
+    unsigned char* pixels;
+    int width, height;
+    /* Sound assets */
+    short* samples;               /* Interleaved by channel */
+    int channels, sample_rate;
+    size_t num_frames;            /* Samples per channel */
+    /* Modification time of the file when requested, zero for files served from archives */
+    unsigned long long mtime;
+};
+
+/*
+  Constructs an asset manager with its worker pool, sized to the processor
+  count unless SHADERVIEW_ASSET_THREADS says otherwise
+ */
+asset_manager_t init_asset_manager();
+/* Deallocates an asset manager, waiting for loads in flight and freeing every asset */
+void free_asset_manager(asset_manager_t am);
+
+/*
+  Queues loading the given file without blocking and returns its handle, zero
+  if the request could not be queued. Requests for a file of the same type and
+  modification time as a live asset share its load, counting a reference each
+ */
+asset_t request_asset(asset_manager_t am, const char* path, enum asset_type type);
+/* Drops a reference to an asset, freeing it with the last one even if still loading */
+void release_asset(asset_manager_t am, asset_t asset);
+
+/*
+  Collects finished loads, meant to be called once per frame. Assets only
+  change state here, so their state is stable between two calls.
+  Returns the number of assets that became ready or failed
+ */
+unsigned int poll_assets(asset_manager_t am);
+/*
+  Blocks until the given asset is ready or failed and returns its state,
+  collecting every load that finishes meanwhile like poll_assets does.
+  Without worker threads it returns ASSET_PENDING instead of blocking
+ */
+enum asset_state wait_asset(asset_manager_t am, asset_t asset);
+/* Retrieves the state of an asset, released handles report ASSET_FAILED */
+enum asset_state get_asset_state(asset_manager_t am, asset_t asset);
+/* Retrieves the contents of a ready asset, valid until its last release. Null otherwise */
+const struct asset_data* get_asset_data(asset_manager_t am, asset_t asset);
+
+#endif // ! _ASSETMGR_H_
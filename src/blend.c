@@ -0,0 +1,253 @@
+#include "blend.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+/* Vector kernels are compiled for their own instruction set and picked at runtime */
+#define BLEND_X86
+#endif
+
+/* Converts a colour channel to an unsigned normalized byte */
+static unsigned char to_unorm8(float v)
+{
+    return (unsigned char)(v <= 0.0f ? 0 : v >= 1.0f ? 255 : v * 255.0f + 0.5f);
+}
+
+/* Colour as a packed RGBA8 pixel, alpha fully opaque */
+static unsigned int pack_rgba8(const float color[3])
+{
+    unsigned char px[4] = { to_unorm8(color[0]), to_unorm8(color[1]), to_unorm8(color[2]), 255 };
+    unsigned int packed;
+    memcpy(&packed, px, 4);
+    return packed;
+}
+
+/* =------------------------------------------------------------------------= */
+/*
+  Scalar kernels, also finishing the rows of the vector ones. The byte blend
+  divides by 255 exactly with rounding, (x + 128 + ((x + 128) >> 8)) >> 8,
+  so that every kernel produces the same bytes
+ */
+static void blend_span_rgba8(unsigned char* dst, const unsigned char* coverage, size_t count, const unsigned char col[4])
+{
+    for (size_t i = 0; i < count; ++i, dst += 4)
+    {
+        unsigned int a = coverage[i];
+        if (a == 0)
+            continue;
+        for (int c = 0; c < 4; ++c)
+        {
+            unsigned int x = dst[c] * (255 - a) + col[c] * a + 128;
+            dst[c] = (unsigned char)((x + (x >> 8)) >> 8);
+        }
+    }
+}
+
+static void blend_row_rgba8(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    unsigned int packed = pack_rgba8(color);
+    blend_span_rgba8(dst, coverage, count, (const unsigned char*)&packed);
+}
+
+static void blend_span_rgba32f(float* dst, const unsigned char* coverage, size_t count, const float col[4])
+{
+    for (size_t i = 0; i < count; ++i, dst += 4)
+    {
+        if (coverage[i] == 0)
+            continue;
+        float a = coverage[i] * (1.0f / 255.0f);
+        for (int c = 0; c < 4; ++c)
+            dst[c] = dst[c] + (col[c] - dst[c]) * a;
+    }
+}
+
+static void blend_row_rgba32f(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    const float col[4] = { color[0], color[1], color[2], 1.0f };
+    blend_span_rgba32f(dst, coverage, count, col);
+}
+
+#ifdef BLEND_X86
+/* =------------------------------------------------------------------------= */
+/* Blends 16 bit channels in place, the same arithmetic as the scalar kernel */
+#define BLEND_EPI16(d, a, col, k255, k128)                                     \
+    d = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(k255, a)), \
+                                    _mm_mullo_epi16(col, a)), k128);            \
+    d = _mm_srli_epi16(_mm_add_epi16(d, _mm_srli_epi16(d, 8)), 8)
+
+/* Four pixels per step, blocks without coverage are skipped and fully covered ones stored */
+__attribute__((target("sse2")))
+static void blend_row_rgba8_sse2(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    unsigned int packed = pack_rgba8(color);
+    unsigned char* out = dst;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k255 = _mm_set1_epi16(255);
+    const __m128i k128 = _mm_set1_epi16(128);
+    const __m128i solid = _mm_set1_epi32((int) packed);
+    const __m128i col = _mm_unpacklo_epi8(solid, zero);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        unsigned int cov;
+        memcpy(&cov, coverage + i, 4);
+        if (cov == 0)
+            continue;
+        if (cov == 0xFFFFFFFFu)
+        {
+            _mm_storeu_si128((__m128i*)(out + i * 4), solid);
+            continue;
+        }
+
+        /* Spread each coverage byte over its pixel's four channels */
+        __m128i a = _mm_cvtsi32_si128((int) cov);
+        a = _mm_unpacklo_epi8(a, a);
+        a = _mm_unpacklo_epi16(a, a);
+
+        __m128i d = _mm_loadu_si128((const __m128i*)(out + i * 4));
+        __m128i d_lo = _mm_unpacklo_epi8(d, zero), a_lo = _mm_unpacklo_epi8(a, zero);
+        __m128i d_hi = _mm_unpackhi_epi8(d, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+        BLEND_EPI16(d_lo, a_lo, col, k255, k128);
+        BLEND_EPI16(d_hi, a_hi, col, k255, k128);
+        _mm_storeu_si128((__m128i*)(out + i * 4), _mm_packus_epi16(d_lo, d_hi));
+    }
+    blend_span_rgba8(out + i * 4, coverage + i, count - i, (const unsigned char*)&packed);
+}
+
+/* Eight pixels per step, unpacking and packing stay within each 128 bit lane so the order survives */
+__attribute__((target("avx2")))
+static void blend_row_rgba8_avx2(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    unsigned int packed = pack_rgba8(color);
+    unsigned char* out = dst;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k255 = _mm256_set1_epi16(255);
+    const __m256i k128 = _mm256_set1_epi16(128);
+    const __m256i spread = _mm256_set1_epi32(0x01010101);
+    const __m256i solid = _mm256_set1_epi32((int) packed);
+    const __m256i col = _mm256_unpacklo_epi8(solid, zero);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        unsigned long long cov;
+        memcpy(&cov, coverage + i, 8);
+        if (cov == 0)
+            continue;
+        if (cov == ~0ULL)
+        {
+            _mm256_storeu_si256((__m256i*)(out + i * 4), solid);
+            continue;
+        }
+
+        __m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(coverage + i)));
+        a = _mm256_mullo_epi32(a, spread);
+
+        __m256i d = _mm256_loadu_si256((const __m256i*)(out + i * 4));
+        __m256i d_lo = _mm256_unpacklo_epi8(d, zero), a_lo = _mm256_unpacklo_epi8(a, zero);
+        __m256i d_hi = _mm256_unpackhi_epi8(d, zero), a_hi = _mm256_unpackhi_epi8(a, zero);
+        d_lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(d_lo, _mm256_sub_epi16(k255, a_lo)),
+                                                 _mm256_mullo_epi16(col, a_lo)), k128);
+        d_lo = _mm256_srli_epi16(_mm256_add_epi16(d_lo, _mm256_srli_epi16(d_lo, 8)), 8);
+        d_hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(d_hi, _mm256_sub_epi16(k255, a_hi)),
+                                                 _mm256_mullo_epi16(col, a_hi)), k128);
+        d_hi = _mm256_srli_epi16(_mm256_add_epi16(d_hi, _mm256_srli_epi16(d_hi, 8)), 8);
+        _mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_packus_epi16(d_lo, d_hi));
+    }
+    blend_span_rgba8(out + i * 4, coverage + i, count - i, (const unsigned char*)&packed);
+}
+
+/* One pixel per vector */
+__attribute__((target("sse2")))
+static void blend_row_rgba32f_sse2(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    float* out = dst;
+    const __m128 col = _mm_setr_ps(color[0], color[1], color[2], 1.0f);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (coverage[i] == 0)
+            continue;
+        __m128 a = _mm_set1_ps(coverage[i] * (1.0f / 255.0f));
+        __m128 d = _mm_loadu_ps(out + i * 4);
+        _mm_storeu_ps(out + i * 4, _mm_add_ps(d, _mm_mul_ps(_mm_sub_ps(col, d), a)));
+    }
+}
+
+/* Two pixels per vector */
+__attribute__((target("avx2")))
+static void blend_row_rgba32f_avx2(void* dst, const unsigned char* coverage, size_t count, const float color[3])
+{
+    float* out = dst;
+    const __m256 col = _mm256_setr_ps(color[0], color[1], color[2], 1.0f, color[0], color[1], color[2], 1.0f);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        if ((coverage[i] | coverage[i + 1]) == 0)
+            continue;
+        float a0 = coverage[i] * (1.0f / 255.0f), a1 = coverage[i + 1] * (1.0f / 255.0f);
+        __m256 a = _mm256_setr_ps(a0, a0, a0, a0, a1, a1, a1, a1);
+        __m256 d = _mm256_loadu_ps(out + i * 4);
+        _mm256_storeu_ps(out + i * 4, _mm256_add_ps(d, _mm256_mul_ps(_mm256_sub_ps(col, d), a)));
+    }
+    blend_row_rgba32f_sse2(out + i * 4, coverage + i, count - i, color);
+}
+
+__attribute__((target("sse2")))
+static void merge_coverage_row_sse2(unsigned char* dst, const unsigned char* src, size_t count)
+{
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_max_epu8(d, s));
+    }
+    for (; i < count; ++i)
+        if (src[i] > dst[i])
+            dst[i] = src[i];
+}
+#endif
+
+/* =------------------------------------------------------------------------= */
+unsigned int get_blend_kernels(enum pixel_format format, struct blend_kernel kernels[MAX_BLEND_KERNELS])
+{
+    int rgba8 = format == PIXEL_RGBA8;
+    unsigned int n = 0;
+    kernels[n].isa = "scalar";
+    kernels[n++].fn = rgba8 ? blend_row_rgba8 : blend_row_rgba32f;
+#ifdef BLEND_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        kernels[n].isa = "sse2";
+        kernels[n++].fn = rgba8 ? blend_row_rgba8_sse2 : blend_row_rgba32f_sse2;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernels[n].isa = "avx2";
+        kernels[n++].fn = rgba8 ? blend_row_rgba8_avx2 : blend_row_rgba32f_avx2;
+    }
+#endif
+    return n;
+}
+
+blend_row_fn select_blend_kernel(enum pixel_format format)
+{
+    struct blend_kernel kernels[MAX_BLEND_KERNELS];
+    return kernels[get_blend_kernels(format, kernels) - 1].fn;
+}
+
+void merge_coverage_row(unsigned char* dst, const unsigned char* src, size_t count)
+{
+#ifdef BLEND_X86
+    if (__builtin_cpu_supports("sse2"))
+    {
+        merge_coverage_row_sse2(dst, src, count);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i)
+        if (src[i] > dst[i])
+            dst[i] = src[i];
+}
@@ -0,0 +1,79 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _BLEND_H_
+#define _BLEND_H_
+
+#include <stddef.h>
+
+/* Pixel formats of CPU side frame buffers */
+enum pixel_format
+{
+    PIXEL_RGBA8,    /* Four unsigned normalized bytes per pixel */
+    PIXEL_RGBA32F   /* Four floats per pixel */
+};
+
+/* Frame buffer in CPU memory, rows top down */
+struct pixel_buffer
+{
+    void* pixels;
+    int width, height;
+    size_t stride;              /* Distance between rows in bytes */
+    enum pixel_format format;
+};
+
+/*
+  Blends an opaque colour over count pixels of a row, weighted by one coverage
+  byte per pixel, i.e. dst = dst + (color - dst) * coverage / 255 for every
+  channel including alpha
+ */
+typedef void(*blend_row_fn)(void* dst, const unsigned char* coverage, size_t count, const float color[3]);
+
+/* Most row blend kernels available per format */
+#define MAX_BLEND_KERNELS 3
+
+/* Row blend kernel and the instruction set it is written for */
+struct blend_kernel
+{
+    const char* isa;            /* "scalar", "sse2" or "avx2" */
+    blend_row_fn fn;
+};
+
+/*
+  Lists the row blend kernels of the given format the running CPU supports,
+  slowest first, and returns their count. They all produce the same pixels
+ */
+unsigned int get_blend_kernels(enum pixel_format format, struct blend_kernel kernels[MAX_BLEND_KERNELS]);
+/* Returns the fastest row blend kernel of the running CPU for the given format */
+blend_row_fn select_blend_kernel(enum pixel_format format);
+/* Keeps the larger of each pair of coverage bytes in dst */
+void merge_coverage_row(unsigned char* dst, const unsigned char* src, size_t count);
+
+#endif // ! _BLEND_H_
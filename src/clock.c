@@ -0,0 +1,67 @@
+#include "clock.h"
+
+void init_clock(struct shader_clock* clk, double fixed_step)
+{
+    clk->time = 0.0;
+    clk->delta = 0.0;
+    clk->frame = 0;
+    clk->fixed_step = fixed_step > 0.0 ? fixed_step : 0.0;
+    clk->paused = 0;
+    clk->pending = 0.0;
+    clk->last_ns = -1;
+}
+
+void tick_clock(struct shader_clock* clk)
+{
+    time_val_t now = get_time_ns();
+
+    /* First tick starts at time zero */
+    if (clk->last_ns < 0)
+    {
+        clk->last_ns = now;
+        clk->delta = 0.0;
+        return;
+    }
+
+    /* Step of this tick */
+    double dt;
+    if (clk->paused)
+    {
+        dt = clk->pending;
+        clk->pending = 0.0;
+    }
+    else if (clk->fixed_step > 0.0)
+        dt = clk->fixed_step;
+    else
+        dt = (double)(now - clk->last_ns) * 1e-9;
+    clk->last_ns = now;
+
+    clk->delta = dt;
+    clk->time += dt;
+    clk->frame++;
+}
+
+void pause_clock(struct shader_clock* clk, int paused)
+{
+    clk->paused = paused;
+    clk->pending = 0.0;
+}
+
+void step_clock(struct shader_clock* clk, double seconds)
+{
+    if (!clk->paused)
+        return;
+    clk->pending += clk->fixed_step > 0.0 ? clk->fixed_step : seconds;
+}
+
+void scrub_clock(struct shader_clock* clk, double seconds)
+{
+    clk->time += seconds;
+    if (clk->time < 0.0)
+        clk->time = 0.0;
+}
+
+void set_clock_step(struct shader_clock* clk, double fixed_step)
+{
+    clk->fixed_step = fixed_step > 0.0 ? fixed_step : 0.0;
+}
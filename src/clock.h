@@ -0,0 +1,74 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include "timer.h"
+
+/*
+  Time base of the shader preview. In realtime mode it follows the
+  monotonic clock, in fixed step mode every tick advances by the same
+  amount regardless of wall time, so frame N always sees the same time.
+  Time is accumulated in double precision, the float value handed to the
+  shaders is derived from it every tick instead of being summed up itself
+ */
+struct shader_clock
+{
+    double time;             /* Seconds of shader time at the current frame */
+    double delta;            /* Seconds of shader time since the previous frame */
+    unsigned long frame;     /* Index of the current frame */
+    double fixed_step;       /* Seconds per tick in fixed step mode, zero in realtime mode */
+    int paused;              /* Non zero while time is frozen */
+    double pending;          /* Seconds queued by steps while paused */
+    time_val_t last_ns;      /* Monotonic timestamp of the previous tick */
+};
+
+/* Initializes a clock at time zero, fixed_step zero selects realtime mode */
+void init_clock(struct shader_clock* clk, double fixed_step);
+/*
+  Advances the clock to the next frame. Must be called once
+  per presented frame, before the frame's uniforms are set
+ */
+void tick_clock(struct shader_clock* clk);
+
+/* Freezes or resumes time, the frame index keeps counting */
+void pause_clock(struct shader_clock* clk, int paused);
+/*
+  Advances a paused clock by a single step on the next tick, the fixed
+  step in fixed step mode or the given seconds otherwise
+ */
+void step_clock(struct shader_clock* clk, double seconds);
+/* Moves time by the given (possibly negative) seconds, clamped at zero */
+void scrub_clock(struct shader_clock* clk, double seconds);
+/* Switches between realtime and fixed step modes without a jump in time */
+void set_clock_step(struct shader_clock* clk, double fixed_step);
+
+#endif // ! _CLOCK_H_
@@ -0,0 +1,447 @@
+#include "compiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderer.h"
+#include "thread.h"
+#include "timer.h"
+#include "progcache.h"
+#include "glcount.h"
+#include "defshdr.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+/* Environment variable forcing a compile mode (sync, parallel or worker) */
+#define COMPILE_MODE_ENV "SHADERVIEW_COMPILE"
+
+/* A program whose compile and link has been issued */
+struct program_build
+{
+    GLuint program;
+    GLuint vert_shader, frag_shader;
+    unsigned long long key;    /* Program cache key of the sources */
+    time_val_t start;          /* Timer value when the build was issued */
+    time_val_t end;            /* Timer value when completion was first observed, zero until then */
+    int cached;                /* Non zero if the program was loaded from the program cache */
+};
+
+struct shader_compiler
+{
+    enum compile_mode mode;
+
+    /* Parallel mode, build in flight */
+    struct program_build build;
+    int in_flight;
+
+    /* Worker mode */
+    shared_context_t shared;
+    thread_t worker;
+    mutex_t lock;
+    condvar_t cv;
+    int worker_state;          /* Zero while starting, positive when running, negative if its context failed */
+    int quit;
+    char* job_vert_src;        /* Sources of the queued job, null selects the builtin */
+    char* job_frag_src;
+    int has_job;
+    unsigned int submitted;    /* Sequence number of the last submitted job */
+    unsigned int result_seq;   /* Sequence number of the finished result */
+    GLuint result;             /* Finished program, zero on failure */
+    int has_result;
+
+    /* Sync mode, result of the last build */
+    enum build_status sync_status;
+    GLuint sync_program;
+};
+
+/* =------------------------------------------------------------------------= */
+/* Checks and shows last shader compile error occurred */
+static int check_last_compile_error(GLuint id)
+{
+    /* Check if last compile was successful */
+    GLint compileStatus;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &compileStatus);
+    if (compileStatus == GL_FALSE)
+    {
+        /* Gather the compile log size */
+        GLint logLength;
+        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &logLength);
+        if (logLength != 0)
+        {
+            /* Fetch and print log */
+            GLchar* buf = malloc(logLength * sizeof(GLchar));
+            glGetShaderInfoLog(id, logLength, 0, buf);
+            fprintf(stderr, "Shader error: %s", buf);
+            free(buf);
+        }
+    }
+    return compileStatus == GL_TRUE;
+}
+
+/* Checks and shows last shader link error occurred */
+static int check_last_link_error(GLuint id)
+{
+    /* Check if last link was successful */
+    GLint status;
+    glGetProgramiv(id, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+    {
+        /* Gather the link log size */
+        GLint logLength;
+        glGetProgramiv(id, GL_INFO_LOG_LENGTH, &logLength);
+        if (logLength != 0)
+        {
+            /* Fetch and print log */
+            GLchar* buf = malloc(logLength * sizeof(GLchar));
+            glGetProgramInfoLog(id, logLength, 0, buf);
+            fprintf(stderr, "Shader program error: %s", buf);
+            free(buf);
+        }
+    }
+    return status == GL_TRUE;
+}
+
+/*
+  Issues compile and link commands without querying any status,
+  so that drivers compiling in the background are not waited on
+ */
+static void begin_build(struct program_build* b, const char* vert_src, const char* frag_src)
+{
+    if (!vert_src)
+        vert_src = def_vert_sh_src;
+    if (!frag_src)
+        frag_src = def_frag_sh_src;
+
+    /* Cache hits are linked already */
+    b->start = get_timer_value();
+    b->end = 0;
+    b->key = program_cache_key(vert_src, frag_src);
+    b->program = load_cached_program(b->key);
+    b->cached = b->program != 0;
+    if (b->cached)
+    {
+        b->vert_shader = b->frag_shader = 0;
+        return;
+    }
+
+    /* Compile vertex shader */
+    b->vert_shader = create_gl_shader(GL_VERTEX_SHADER);
+    glShaderSource(b->vert_shader, 1, &vert_src, 0);
+    glCompileShader(b->vert_shader);
+
+    /* Compile fragment shader */
+    b->frag_shader = create_gl_shader(GL_FRAGMENT_SHADER);
+    glShaderSource(b->frag_shader, 1, &frag_src, 0);
+    glCompileShader(b->frag_shader);
+
+    /* Link shader program */
+    b->program = create_gl_program();
+    glAttachShader(b->program, b->vert_shader);
+    glAttachShader(b->program, b->frag_shader);
+    glBindAttribLocation(b->program, 0, "position");
+    prepare_cached_program(b->program);
+    glLinkProgram(b->program);
+}
+
+/* Releases the build's shaders, returning its program or zero on failure */
+static GLuint end_build(struct program_build* b)
+{
+    if (b->cached)
+        return b->program;
+
+    /* Shader logs explain link failures better than the link log */
+    int ok = check_last_compile_error(b->vert_shader);
+    ok = check_last_compile_error(b->frag_shader) && ok;
+    ok = ok && check_last_link_error(b->program);
+
+    /* The linked program no longer needs its shaders */
+    glDetachShader(b->program, b->vert_shader);
+    glDetachShader(b->program, b->frag_shader);
+    glDeleteShader(b->vert_shader);
+    glDeleteShader(b->frag_shader);
+    if (!ok)
+    {
+        glDeleteProgram(b->program);
+        return 0;
+    }
+
+    /*
+      Build time as observed by the caller, which is what a later hit saves.
+      Parallel builds are timed to the poll that first saw them complete
+     */
+    time_val_t end = b->end ? b->end : get_timer_value();
+    double build_ms = (double)(end - b->start) * 1000.0 / get_timer_precision();
+    store_cached_program(b->key, b->program, build_ms);
+    return b->program;
+}
+
+/* Drops a build without waiting on it */
+static void abandon_build(struct program_build* b)
+{
+    glDeleteProgram(b->program);
+    glDeleteShader(b->vert_shader);
+    glDeleteShader(b->frag_shader);
+}
+
+GLuint build_program(const char* vert_src, const char* frag_src)
+{
+    struct program_build b;
+    begin_build(&b, vert_src, frag_src);
+    return end_build(&b);
+}
+
+/* Duplicates a nullable string */
+static char* copy_src(const char* src)
+{
+    if (!src)
+        return 0;
+    char* s = malloc(strlen(src) + 1);
+    strcpy(s, src);
+    return s;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Worker thread loop building queued jobs on the shared context */
+static void compile_worker(void* arg)
+{
+    shader_compiler_t sc = arg;
+
+    /* Report whether the context could be bound */
+    int ok = make_shared_context_current(sc->shared);
+    mutex_lock(sc->lock);
+    sc->worker_state = ok ? 1 : -1;
+    condvar_broadcast(sc->cv);
+    if (!ok)
+    {
+        mutex_unlock(sc->lock);
+        return;
+    }
+
+    for (;;)
+    {
+        while (!sc->has_job && !sc->quit)
+            condvar_wait(sc->cv, sc->lock);
+        if (sc->quit)
+            break;
+
+        /* Take the job */
+        char* vert_src = sc->job_vert_src;
+        char* frag_src = sc->job_frag_src;
+        unsigned int seq = sc->submitted;
+        sc->has_job = 0;
+        mutex_unlock(sc->lock);
+
+        /* Build, and make sure it is complete before another context uses it */
+        GLuint program = build_program(vert_src, frag_src);
+        glFinish();
+        free(vert_src);
+        free(frag_src);
+
+        /* Publish, replacing an uncollected older result */
+        mutex_lock(sc->lock);
+        if (sc->has_result && sc->result)
+            glDeleteProgram(sc->result);
+        sc->result = program;
+        sc->result_seq = seq;
+        sc->has_result = 1;
+    }
+    mutex_unlock(sc->lock);
+    release_shared_context(sc->shared);
+}
+
+/* Starts the worker thread, returns zero if it could not get a context */
+static int start_worker(shader_compiler_t sc, struct window* wnd)
+{
+    sc->shared = create_shared_context(wnd);
+    if (!sc->shared)
+        return 0;
+
+    sc->lock = mutex_create();
+    sc->cv = condvar_create();
+    sc->worker = thread_create(compile_worker, sc);
+
+    /* Wait for the worker to bind its context */
+    int state = -1;
+    if (sc->worker)
+    {
+        mutex_lock(sc->lock);
+        while (sc->worker_state == 0)
+            condvar_wait(sc->cv, sc->lock);
+        state = sc->worker_state;
+        mutex_unlock(sc->lock);
+    }
+
+    if (state < 0)
+    {
+        if (sc->worker)
+            thread_join(sc->worker);
+        destroy_shared_context(sc->shared);
+        condvar_destroy(sc->cv);
+        mutex_destroy(sc->lock);
+        sc->worker = 0;
+        sc->shared = 0;
+        return 0;
+    }
+    return 1;
+}
+
+/* Checks for the parallel compile extension in the current context */
+static int has_parallel_compile()
+{
+    GLint num_exts = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_exts);
+    for (GLint i = 0; i < num_exts; ++i)
+    {
+        const char* ext = (const char*) glGetStringi(GL_EXTENSIONS, i);
+        if (strcmp(ext, "GL_KHR_parallel_shader_compile") == 0
+         || strcmp(ext, "GL_ARB_parallel_shader_compile") == 0)
+            return 1;
+    }
+    return 0;
+}
+
+shader_compiler_t init_shader_compiler(struct window* wnd)
+{
+    shader_compiler_t sc = calloc(1, sizeof(struct shader_compiler));
+
+    /* Honour forced mode */
+    const char* forced = getenv(COMPILE_MODE_ENV);
+    int want_parallel = !forced || strcmp(forced, "parallel") == 0;
+    int want_worker = !forced || strcmp(forced, "worker") == 0;
+
+    if (want_parallel && has_parallel_compile())
+        sc->mode = COMPILE_PARALLEL;
+    else if (want_worker && start_worker(sc, wnd))
+        sc->mode = COMPILE_WORKER;
+    else
+        sc->mode = COMPILE_SYNC;
+    return sc;
+}
+
+void free_shader_compiler(shader_compiler_t sc)
+{
+    switch (sc->mode)
+    {
+        case COMPILE_PARALLEL:
+            if (sc->in_flight)
+                abandon_build(&sc->build);
+            break;
+        case COMPILE_WORKER:
+            mutex_lock(sc->lock);
+            sc->quit = 1;
+            condvar_broadcast(sc->cv);
+            mutex_unlock(sc->lock);
+            thread_join(sc->worker);
+            if (sc->has_job)
+            {
+                free(sc->job_vert_src);
+                free(sc->job_frag_src);
+            }
+            if (sc->has_result && sc->result)
+                glDeleteProgram(sc->result);
+            destroy_shared_context(sc->shared);
+            condvar_destroy(sc->cv);
+            mutex_destroy(sc->lock);
+            break;
+        case COMPILE_SYNC:
+            if (sc->sync_status == BUILD_DONE)
+                glDeleteProgram(sc->sync_program);
+            break;
+    }
+    free(sc);
+}
+
+enum compile_mode get_compile_mode(shader_compiler_t sc)
+{
+    return sc->mode;
+}
+
+/* =------------------------------------------------------------------------= */
+void submit_program(shader_compiler_t sc, const char* vert_src, const char* frag_src)
+{
+    switch (sc->mode)
+    {
+        case COMPILE_PARALLEL:
+            if (sc->in_flight)
+                abandon_build(&sc->build);
+            begin_build(&sc->build, vert_src, frag_src);
+            sc->in_flight = 1;
+            break;
+        case COMPILE_WORKER:
+            mutex_lock(sc->lock);
+            if (sc->has_job)
+            {
+                free(sc->job_vert_src);
+                free(sc->job_frag_src);
+            }
+            sc->job_vert_src = copy_src(vert_src);
+            sc->job_frag_src = copy_src(frag_src);
+            sc->has_job = 1;
+            sc->submitted++;
+            condvar_signal(sc->cv);
+            mutex_unlock(sc->lock);
+            break;
+        case COMPILE_SYNC:
+            if (sc->sync_status == BUILD_DONE)
+                glDeleteProgram(sc->sync_program);
+            sc->sync_program = build_program(vert_src, frag_src);
+            sc->sync_status = sc->sync_program ? BUILD_DONE : BUILD_FAILED;
+            break;
+    }
+}
+
+enum build_status poll_program(shader_compiler_t sc, GLuint* program)
+{
+    enum build_status status = BUILD_IDLE;
+    switch (sc->mode)
+    {
+        case COMPILE_PARALLEL:
+        {
+            if (!sc->in_flight)
+                break;
+            GLint done = GL_FALSE;
+            glGetProgramiv(sc->build.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (done == GL_FALSE)
+            {
+                status = BUILD_PENDING;
+                break;
+            }
+            sc->build.end = get_timer_value();
+            sc->in_flight = 0;
+            *program = end_build(&sc->build);
+            status = *program ? BUILD_DONE : BUILD_FAILED;
+            break;
+        }
+        case COMPILE_WORKER:
+        {
+            mutex_lock(sc->lock);
+            if (sc->has_result)
+            {
+                sc->has_result = 0;
+                if (sc->result_seq != sc->submitted)
+                {
+                    /* Superseded by a newer job */
+                    if (sc->result)
+                        glDeleteProgram(sc->result);
+                    status = BUILD_PENDING;
+                }
+                else
+                {
+                    *program = sc->result;
+                    status = sc->result ? BUILD_DONE : BUILD_FAILED;
+                }
+            }
+            else if (sc->has_job || sc->result_seq != sc->submitted)
+                status = BUILD_PENDING;
+            mutex_unlock(sc->lock);
+            break;
+        }
+        case COMPILE_SYNC:
+            status = sc->sync_status;
+            *program = sc->sync_program;
+            sc->sync_status = BUILD_IDLE;
+            break;
+    }
+    return status;
+}
@@ -0,0 +1,84 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _COMPILER_H_
+#define _COMPILER_H_
+
+#include <glad/glad.h>
+#include "window.h"
+
+/* Opaque datatype that builds shader programs off the frame loop */
+typedef struct shader_compiler* shader_compiler_t;
+
+/* How programs get built */
+enum compile_mode
+{
+    COMPILE_SYNC = 0, /* Blocking build on the calling thread */
+    COMPILE_PARALLEL, /* Driver side through GL_KHR_parallel_shader_compile */
+    COMPILE_WORKER    /* Worker thread with a context shared with the window's one */
+};
+
+/* State of the last submitted build */
+enum build_status
+{
+    BUILD_IDLE = 0, /* Nothing submitted or result already collected */
+    BUILD_PENDING,  /* Still compiling */
+    BUILD_DONE,     /* Linked successfully */
+    BUILD_FAILED    /* Compile or link error, log already printed */
+};
+
+/*
+  Compiles and links a program from the given sources on the calling thread,
+  null sources select the builtin shaders. Returns zero on failure
+ */
+GLuint build_program(const char* vert_src, const char* frag_src);
+
+/*
+  Constructs a shader compiler for the given window's context, picking
+  the parallel compile extension when available, then a worker thread,
+  falling back to synchronous builds
+ */
+shader_compiler_t init_shader_compiler(struct window* wnd);
+/* Deallocates a shader compiler, waiting for any in flight build */
+void free_shader_compiler(shader_compiler_t sc);
+/* Retrieves the build mode in use */
+enum compile_mode get_compile_mode(shader_compiler_t sc);
+
+/* Starts building a program from the given sources, superseding any build in flight */
+void submit_program(shader_compiler_t sc, const char* vert_src, const char* frag_src);
+/*
+  Polls the last submitted build without blocking.
+  On BUILD_DONE the linked program is stored and owned by the caller.
+  Parallel builds only complete when polled, so their timings include
+  the delay until the poll that observed completion
+ */
+enum build_status poll_program(shader_compiler_t sc, GLuint* program);
+
+#endif // ! _COMPILER_H_
@@ -0,0 +1,208 @@
+#include "filewatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#else
+#include <sys/stat.h>
+#endif
+
+/* Maximum number of watched files */
+#define MAX_WATCHED_FILES 16
+
+/* A single watched file */
+struct watched_file
+{
+    char* path;            /* Path as given by the user */
+#ifdef __linux__
+    int wd;                /* Watch descriptor of the containing directory */
+    const char* name;      /* File name inside the containing directory */
+#else
+    time_t mtime;          /* Last seen modification time */
+    long size;             /* Last seen file size */
+#endif
+};
+
+/*
+  Holds the watched file set and the
+  state of the currently settling change
+ */
+struct filewatch
+{
+#ifdef __linux__
+    int fd;                /* The inotify instance */
+#endif
+    struct watched_file files[MAX_WATCHED_FILES];
+    size_t num_files;
+
+    time_val_t settle;     /* Quiet period in timer counts */
+    int pending;           /* Non zero while a change burst is settling */
+    time_val_t first_ev;   /* Timer value of the first event in the burst */
+    time_val_t last_ev;    /* Timer value of the last event in the burst */
+};
+
+/* =------------------------------------------------------------------------= */
+filewatch_t init_filewatch(unsigned int settle_ms)
+{
+    filewatch_t fw = calloc(1, sizeof(struct filewatch));
+    fw->settle = (get_timer_precision() * settle_ms) / 1000;
+#ifdef __linux__
+    fw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fw->fd < 0)
+        fprintf(stderr, "inotify_init1 failed: %s\n", strerror(errno));
+#endif
+    return fw;
+}
+
+void free_filewatch(filewatch_t fw)
+{
+#ifdef __linux__
+    if (fw->fd >= 0)
+        close(fw->fd);
+#endif
+    for (size_t i = 0; i < fw->num_files; ++i)
+        free(fw->files[i].path);
+    free(fw);
+}
+
+/* Marks a modification of a watched file */
+static void note_event(filewatch_t fw)
+{
+    time_val_t now = get_timer_value();
+    if (!fw->pending)
+    {
+        fw->pending = 1;
+        fw->first_ev = now;
+    }
+    fw->last_ev = now;
+}
+
+/* =------------------------------------------------------------------------= */
+#ifdef __linux__
+int watch_file(filewatch_t fw, const char* path)
+{
+    if (fw->fd < 0 || fw->num_files == MAX_WATCHED_FILES)
+        return 0;
+
+    struct watched_file* wf = fw->files + fw->num_files;
+    wf->path = malloc(strlen(path) + 1);
+    strcpy(wf->path, path);
+
+    /*
+     Watch the containing directory rather than the file itself,
+     editors that save by renaming a temporary over the original
+     would otherwise leave us watching a deleted inode
+     */
+    char* sep = strrchr(wf->path, '/');
+    char* dir;
+    if (sep)
+    {
+        size_t dir_len = sep == wf->path ? 1 : (size_t)(sep - wf->path);
+        dir = malloc(dir_len + 1);
+        memcpy(dir, wf->path, dir_len);
+        dir[dir_len] = '\0';
+        wf->name = sep + 1;
+    }
+    else
+    {
+        dir = malloc(2);
+        strcpy(dir, ".");
+        wf->name = wf->path;
+    }
+
+    /* Adding a directory twice returns the same descriptor */
+    wf->wd = inotify_add_watch(fw->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_MODIFY);
+    if (wf->wd < 0)
+    {
+        fprintf(stderr, "Could not watch %s: %s\n", dir, strerror(errno));
+        free(dir);
+        free(wf->path);
+        return 0;
+    }
+    free(dir);
+
+    fw->num_files++;
+    return 1;
+}
+
+/* Drains the inotify queue, noting events that touch watched files */
+static void read_events(filewatch_t fw)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    for (;;)
+    {
+        ssize_t len = read(fw->fd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+
+        for (char* p = buf; p < buf + len; )
+        {
+            const struct inotify_event* ev = (const struct inotify_event*) p;
+            p += sizeof(struct inotify_event) + ev->len;
+            if (ev->len == 0)
+                continue;
+            for (size_t i = 0; i < fw->num_files; ++i)
+            {
+                if (fw->files[i].wd == ev->wd && strcmp(fw->files[i].name, ev->name) == 0)
+                {
+                    note_event(fw);
+                    break;
+                }
+            }
+        }
+    }
+}
+#else
+int watch_file(filewatch_t fw, const char* path)
+{
+    if (fw->num_files == MAX_WATCHED_FILES)
+        return 0;
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+
+    struct watched_file* wf = fw->files + fw->num_files++;
+    wf->path = malloc(strlen(path) + 1);
+    strcpy(wf->path, path);
+    wf->mtime = st.st_mtime;
+    wf->size = (long) st.st_size;
+    return 1;
+}
+
+/* Compares each file's modification stamp against the last seen one */
+static void read_events(filewatch_t fw)
+{
+    for (size_t i = 0; i < fw->num_files; ++i)
+    {
+        struct watched_file* wf = fw->files + i;
+        struct stat st;
+        if (stat(wf->path, &st) != 0)
+            continue;
+        if (st.st_mtime != wf->mtime || (long) st.st_size != wf->size)
+        {
+            wf->mtime = st.st_mtime;
+            wf->size = (long) st.st_size;
+            note_event(fw);
+        }
+    }
+}
+#endif
+
+int poll_filewatch(filewatch_t fw, time_val_t* changed_at)
+{
+    read_events(fw);
+
+    /* Report only once the burst has gone quiet */
+    if (fw->pending && get_timer_value() - fw->last_ev >= fw->settle)
+    {
+        fw->pending = 0;
+        if (changed_at)
+            *changed_at = fw->first_ev;
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,19 @@
 #include "font.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stddef.h>
+#include <stb_rect_pack.h>
 #include <stb_truetype.h>
 #include <glad/glad.h>
 #include "vecmath.h"
+#include "glcount.h"
+#include "compiler.h"
+#include "thread.h"
+#include "assetload.h"
+#include "blend.h"
+#include "hash.h"
 
 /*
   Stores data about a certain glyph's codepoint,
@@ -15,24 +25,227 @@ struct font_glyph_info
     int codepoint;        /* Codepoint the glyph corresponds to */
     struct ivec2 offset;  /* Offset in atlas bitmap */
     struct ivec2 size;    /* Bounding box size */
-    struct ivec2 bearing; /* Bearing */
+    struct ivec2 bearing; /* Box corner left of and above the pen position on the baseline */
     long advance;         /* Distance to next font */
 };
 
+/* Empty texels kept around each packed glyph, so that linear filtering never picks up a neighbour */
+#define ATLAS_PADDING 1
+
+/* Minimum number of cache cells for glyphs rasterized on demand */
+#define GLYPH_CACHE_CELLS 128
+
+/* Codepoints below this are looked up by direct indexing, covering ASCII and Latin-1 */
+#define GLYPH_DIRECT_RANGE 256
+
+/* Environment variable capping the number of threads glyphs are baked on */
+#define BAKE_THREADS_ENV "SHADERVIEW_FONT_THREADS"
+/* Glyphs a bake worker claims at a time */
+#define BAKE_BATCH 8
+
+/* Baked font cache file identification */
+#define BAKED_MAGIC   0x46425653u /* "SVBF" */
+#define BAKED_VERSION 4u
+
+/* Key of the empty kerning pair slots */
+#define KERN_EMPTY 0xFFFFFFFFu
+
+/* Pixel height distance field fonts are baked at, any drawn size is scaled from it */
+#define SDF_BASE_HEIGHT 32.0f
+/* Distance in texels covered by the field on either side of an outline */
+#define SDF_SPREAD 4
+/* Squared distance standing in for infinity in the distance transforms */
+#define SDF_INF 1e20f
+
+/* Slot of the sparse codepoint map, empty when codepoint is negative */
+struct glyph_slot
+{
+    int codepoint;
+    int index;            /* Index in the glyph info array */
+};
+
+/* Slot of the kerning pair map */
+struct kern_pair
+{
+    unsigned int key;     /* Left times the number of packed glyphs plus right glyph info index, KERN_EMPTY when free */
+    int amount;           /* Pixels added to the advance of the left glyph */
+};
+
+/*
+  Header of a baked font cache file. The packed glyph infos, the kerning
+  map and the atlas bitmap follow, each starting 16 byte aligned
+ */
+struct baked_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long source_hash;   /* Hash of all of the font file data the atlas was baked from */
+    unsigned long long source_size;
+    unsigned long long source_mtime;  /* Modification time of the font file, zero when unknown */
+    float pixel_height;
+    int sdf_spread;
+    unsigned int glyph_info_size;     /* Guards against files written by builds with another struct layout */
+
+    /* Font fields restored as is */
+    int ascent, line_height, cell_width;
+    int tex_width, tex_height;
+    int cache_y, cell_w, cell_h, cache_cols;
+    unsigned int num_cells;
+    unsigned int num_glyphs;
+    unsigned int kern_cap;
+};
+
+/* Allocation that only ever grows, kept for reuse */
+struct pool_block
+{
+    void* data;
+    size_t size;
+};
+
 /*
   Contains a texture atlas generated for a specific
   font and size, with its accompanied glyph info
  */
 struct font
 {
-    /* The parsed font data as a bitmap */
+    /*
+     Baked font cache file mapping, that the bitmap and the kerning map
+     point into when the font was loaded from it, null when they are owned
+     */
+    void* baked;
+    size_t baked_size;
+
+    /* The parsed font data as a bitmap, power of two sized */
     unsigned char* tex_data;
     int tex_width;
     int tex_height;
 
-    /* Info for each glyph in bitmap */
+    /* Pixel metrics */
+    int ascent;           /* Baseline distance from the top of a line */
+    int line_height;      /* Ascent plus descent */
+    int cell_width;       /* Widest advance */
+    float pixel_height;   /* Height the glyphs were baked at */
+
+    /*
+     Distance field margin around each glyph in texels, zero for coverage
+     bitmaps. Distance fields store 0.5 on the outline, increasing inwards
+     */
+    int sdf_spread;
+
+    /* GPU copy of the bitmap, created on first use */
+    GLuint atlas;
+
+    /* Storage kept when the font is unloaded, reused by the next font loaded into its slot */
+    struct pool_block glyph_pool;   /* Backs glyphs */
+    struct pool_block tex_pool;     /* Backs tex_data unless it points into the baked mapping */
+    GLuint atlas_pool;              /* Texture of a previous font's atlas, respecified on upload */
+
+    /* Info for each glyph in bitmap, the packed ones followed by the cache cells */
     struct font_glyph_info* glyphs;
-    size_t num_glyphs;
+    size_t num_glyphs;    /* Number of packed glyphs */
+
+    /* Source of the glyphs rasterized on demand, references the buffer given to load_font */
+    stbtt_fontinfo info;
+    float scale;
+
+    /*
+     Grid of equally sized cells below the packed glyphs, holding the
+     glyphs rasterized on demand. Full grids evict the least recently used
+     */
+    int cache_y;          /* Top row of the grid in the atlas */
+    int cell_w, cell_h;   /* Cell size, including padding */
+    int cache_cols;
+    size_t num_cells;
+    unsigned long* cell_used; /* Value of use_clock when each cell was last drawn, zero when free */
+    unsigned long* cell_generation; /* Bumped whenever a cell's glyph is evicted */
+    unsigned long use_clock;  /* Incremented on every drawn string */
+
+    /* Glyph indices of the codepoints below GLYPH_DIRECT_RANGE, -1 when missing */
+    int direct[GLYPH_DIRECT_RANGE];
+    /* Open addressing map (linear probing) of the remaining codepoints */
+    struct glyph_slot* sparse;
+    size_t sparse_cap;    /* Power of two, zero when empty */
+    size_t sparse_count;
+
+    /* Non zero kerning between packed glyphs, open addressing map (linear probing) */
+    struct kern_pair* kerning;
+    size_t kern_cap;      /* Power of two, zero when the font has no kerning */
+};
+
+/* Number of laid out strings kept by a fontstash */
+#define LAYOUT_CACHE_SIZE 64
+/*
+  Number of strings drawn once remembered by a fontstash. Strings are only
+  cached when drawn again, so text changing every frame does not flush the cache
+ */
+#define LAYOUT_SEEN_SIZE 64
+
+/*
+  GL objects shared by the text draws of a fontstash,
+  created on the first draw and reused afterwards
+ */
+struct text_program
+{
+    GLuint program;
+    GLint projection_loc, offset_loc, color_loc, sampler_loc;
+};
+
+/* Cache cell a layout's quads point into, with the cell's generation when laid out */
+struct layout_cell
+{
+    size_t cell;
+    unsigned long generation;
+};
+
+/*
+  Laid out string with its quads resident on the GPU. Quads are relative to
+  the draw position, which together with the colour is a uniform, so that
+  neither of them is part of the key
+ */
+struct text_layout
+{
+    struct font* font;               /* Null when the entry is free */
+    unsigned long long hash;   /* Hash of the string, checked before comparing it */
+    char* string;              /* Copy of the laid out string */
+    float pixel_height;
+    float wrap_width;          /* Zero when lines only break at newlines */
+    GLuint vao, vbo;           /* Kept when the entry is recycled, zero until first used */
+    size_t num_quads;
+    struct layout_cell* cells; /* Cache cells used, an evicted one may have moved its glyph */
+    size_t num_cells, cells_cap;
+    unsigned long last_used;   /* Value of draw_clock when last drawn */
+};
+
+struct text_pipeline
+{
+    struct text_program coverage;  /* Draws coverage bitmap fonts */
+    struct text_program sdf;       /* Draws distance field fonts */
+    GLuint ebo;                /* Static quad indices, shared by the layouts */
+    GLfloat* vertices;         /* CPU staging of the quads */
+    size_t max_quads;          /* Quad capacity of the staging and index buffers */
+    struct text_layout layouts[LAYOUT_CACHE_SIZE];
+    struct text_layout transient;  /* Lays out the strings not cached, reusing its GL objects for each */
+    unsigned long long seen[LAYOUT_SEEN_SIZE];  /* Hashes of strings recently drawn uncached */
+    size_t seen_next;          /* Oldest entry of seen, overwritten next */
+    unsigned long draw_clock;  /* Incremented on every draw */
+};
+
+/*
+  Font handles hold the slot index in the low bits and the slot's generation
+  above it. Generations start at one, so that zero is never a valid handle
+ */
+#define FONT_INDEX_BITS 16
+#define FONT_INDEX_MASK ((1u << FONT_INDEX_BITS) - 1)
+#define FONT_MAX_SLOTS  (1u << FONT_INDEX_BITS)
+#define FONT_NO_SLOT    0xFFFFFFFFu
+
+/* Slot holding a font, or a link of the free list */
+struct font_slot
+{
+    struct font* font;          /* Pooled storage, allocated on first use and kept afterwards */
+    unsigned int generation;    /* Bumped on unload, so that old handles stop matching */
+    unsigned int next_free;     /* Next free slot while unused */
+    int used;
 };
 
 /*
@@ -40,30 +253,477 @@ struct font
  */
 struct fontstash
 {
-    font_t* fonts;
+    struct font_slot* slots;
+    unsigned int num_slots;     /* Slots ever used */
+    unsigned int slot_cap;
+    unsigned int free_slot;     /* Head of the free list, FONT_NO_SLOT when empty */
     size_t num_fonts;
+    int no_disk_cache;          /* Loads bake every time, without the baked font cache */
+
+    /* Zero ebo until the first draw */
+    struct text_pipeline pipeline;
 };
 
+static struct font* get_font(fontstash_t fs, font_t handle);
+static void destroy_text_pipeline(struct text_pipeline* tp);
+static void forget_text_layouts(struct text_pipeline* tp, struct font* font);
+
 /* =------------------------------------------------------------------------= */
-/* Frees resources for a given font instance */
-static void free_font(font_t font)
+/* Grows a pooled allocation to at least the given size, keeping its contents */
+static void* reserve_pool(struct pool_block* b, size_t size)
+{
+    if (size > b->size)
+    {
+        b->data = realloc(b->data, size);
+        b->size = size;
+    }
+    return b->data;
+}
+
+/* Frees resources for a given font instance, except for its pooled storage */
+static void release_font(struct font* font)
+{
+    if (font->atlas)
+    {
+        if (font->atlas_pool)
+            glDeleteTextures(1, &font->atlas_pool);
+        font->atlas_pool = font->atlas;
+        font->atlas = 0;
+    }
+    if (font->baked)
+        unmap_file(font->baked, font->baked_size);
+    else
+        free(font->kerning);
+    free(font->sparse);
+    free(font->cell_used);
+    free(font->cell_generation);
+    font->baked = 0;
+    font->kerning = 0;
+    font->sparse = 0;
+    font->cell_used = 0;
+    font->cell_generation = 0;
+}
+
+/* Clears a released font for reuse, keeping its pooled storage */
+static void reset_font(struct font* font)
+{
+    struct pool_block glyph_pool = font->glyph_pool, tex_pool = font->tex_pool;
+    GLuint atlas_pool = font->atlas_pool;
+    memset(font, 0, sizeof(*font));
+    font->glyph_pool = glyph_pool;
+    font->tex_pool = tex_pool;
+    font->atlas_pool = atlas_pool;
+}
+
+/* Frees a released font along with its pooled storage */
+static void destroy_font(struct font* font)
 {
-    free(font->tex_data);
-    free(font->glyphs);
+    if (font->atlas_pool)
+        glDeleteTextures(1, &font->atlas_pool);
+    free(font->glyph_pool.data);
+    free(font->tex_pool.data);
     free(font);
 }
 
+/* =------------------------------------------------------------------------= */
+/* Spreads consecutive codepoints over the table (Fibonacci hashing) */
+static size_t hash_codepoint(int codepoint, size_t cap)
+{
+    return (size_t)(((unsigned int) codepoint * 2654435769u) >> 7) & (cap - 1);
+}
+
+/* Inserts into the sparse map, which must have a free slot */
+static void sparse_insert(struct glyph_slot* slots, size_t cap, int codepoint, int index)
+{
+    size_t i = hash_codepoint(codepoint, cap);
+    while (slots[i].codepoint >= 0 && slots[i].codepoint != codepoint)
+        i = (i + 1) & (cap - 1);
+    slots[i].codepoint = codepoint;
+    slots[i].index = index;
+}
+
+/* Maps a codepoint to the given glyph info index */
+static void index_glyph(struct font* font, int codepoint, int index)
+{
+    if (codepoint >= 0 && codepoint < GLYPH_DIRECT_RANGE)
+    {
+        font->direct[codepoint] = index;
+        return;
+    }
+
+    /* Keep the load factor at most one half so that probe sequences stay short */
+    if ((font->sparse_count + 1) * 2 > font->sparse_cap)
+    {
+        size_t cap = font->sparse_cap ? font->sparse_cap * 2 : 16;
+        struct glyph_slot* slots = malloc(cap * sizeof(struct glyph_slot));
+        for (size_t i = 0; i < cap; ++i)
+            slots[i].codepoint = -1;
+        for (size_t i = 0; i < font->sparse_cap; ++i)
+            if (font->sparse[i].codepoint >= 0)
+                sparse_insert(slots, cap, font->sparse[i].codepoint, font->sparse[i].index);
+        free(font->sparse);
+        font->sparse = slots;
+        font->sparse_cap = cap;
+    }
+    sparse_insert(font->sparse, font->sparse_cap, codepoint, index);
+    font->sparse_count++;
+}
+
+/* Removes a codepoint's mapping */
+static void unindex_glyph(struct font* font, int codepoint)
+{
+    if (codepoint >= 0 && codepoint < GLYPH_DIRECT_RANGE)
+    {
+        font->direct[codepoint] = -1;
+        return;
+    }
+    if (font->sparse_count == 0)
+        return;
+
+    size_t mask = font->sparse_cap - 1;
+    struct glyph_slot* slots = font->sparse;
+    size_t i = hash_codepoint(codepoint, font->sparse_cap);
+    while (slots[i].codepoint != codepoint)
+    {
+        if (slots[i].codepoint < 0)
+            return;
+        i = (i + 1) & mask;
+    }
+
+    /*
+     Backward shift deletion, entries of the following run that would become
+     unreachable across the hole move into it, so no tombstones are needed
+     */
+    for (size_t j = (i + 1) & mask; slots[j].codepoint >= 0; j = (j + 1) & mask)
+    {
+        size_t home = hash_codepoint(slots[j].codepoint, font->sparse_cap);
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].codepoint = -1;
+    font->sparse_count--;
+}
+
+/* Builds the lookup tables of the font's glyph info array */
+static void index_glyphs(struct font* font)
+{
+    for (int i = 0; i < GLYPH_DIRECT_RANGE; ++i)
+        font->direct[i] = -1;
+    font->sparse = 0;
+    font->sparse_cap = 0;
+    font->sparse_count = 0;
+    for (size_t i = 0; i < font->num_glyphs; ++i)
+        index_glyph(font, font->glyphs[i].codepoint, (int) i);
+}
+
+/* =------------------------------------------------------------------------= */
+/*
+  Precomputes the kerning of every pair of packed glyphs, keeping the non zero
+  ones. Only the legacy kern table is read, like stb_truetype does
+ */
+static void build_kerning_table(struct font* font)
+{
+    font->kerning = 0;
+    font->kern_cap = 0;
+    if (!font->info.kern)
+        return;
+
+    /* Gather the pairs first, so that the map is sized once */
+    size_t n = font->num_glyphs;
+    int* glyph_ids = malloc(n * sizeof(int));
+    for (size_t i = 0; i < n; ++i)
+        glyph_ids[i] = stbtt_FindGlyphIndex(&font->info, font->glyphs[i].codepoint);
+    struct kern_pair* pairs = 0;
+    size_t count = 0, cap = 0;
+    for (size_t l = 0; l < n; ++l)
+    {
+        for (size_t r = 0; r < n; ++r)
+        {
+            int kern = stbtt_GetGlyphKernAdvance(&font->info, glyph_ids[l], glyph_ids[r]);
+            int amount = (int) floorf(kern * font->scale + 0.5f);
+            if (amount == 0)
+                continue;
+            if (count == cap)
+            {
+                cap = cap ? cap * 2 : 64;
+                pairs = realloc(pairs, cap * sizeof(struct kern_pair));
+            }
+            pairs[count].key = (unsigned int)(l * n + r);
+            pairs[count].amount = amount;
+            ++count;
+        }
+    }
+    free(glyph_ids);
+
+    if (count > 0)
+    {
+        /* Load factor at most one half */
+        size_t map_cap = 16;
+        while (map_cap < count * 2)
+            map_cap *= 2;
+        font->kerning = malloc(map_cap * sizeof(struct kern_pair));
+        for (size_t i = 0; i < map_cap; ++i)
+            font->kerning[i].key = KERN_EMPTY;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t j = hash_codepoint((int) pairs[i].key, map_cap);
+            while (font->kerning[j].key != KERN_EMPTY)
+                j = (j + 1) & (map_cap - 1);
+            font->kerning[j] = pairs[i];
+        }
+        font->kern_cap = map_cap;
+    }
+    free(pairs);
+}
+
+/*
+  Fills the atlas independent glyph info of a codepoint. Distance field
+  boxes are the bitmap box grown by the spread on every side. Empty glyphs
+  get an empty box. The bearing is the box's top left corner relative to the
+  pen, so it includes the spread. Boxes are measured at the given scale,
+  the advance at the font's
+ */
+static void measure_glyph(struct font* font, int codepoint, float scale, struct font_glyph_info* gi)
+{
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetCodepointBitmapBox(&font->info, codepoint, scale, scale, &ix0, &iy0, &ix1, &iy1);
+    if (ix1 <= ix0 || iy1 <= iy0)
+        ix1 = ix0 = iy1 = iy0 = 0;
+    else if (font->sdf_spread)
+    {
+        ix0 -= font->sdf_spread;
+        iy0 -= font->sdf_spread;
+        ix1 += font->sdf_spread;
+        iy1 += font->sdf_spread;
+    }
+
+    int advance;
+    stbtt_GetCodepointHMetrics(&font->info, codepoint, &advance, 0);
+    gi->codepoint = codepoint;
+    gi->advance = (int)(advance * font->scale);
+    gi->size.x = ix1 - ix0;
+    gi->size.y = iy1 - iy0;
+    gi->bearing.x = ix0;
+    gi->bearing.y = iy1;
+}
+
+/*
+  One dimensional squared euclidean distance transform (Felzenszwalb and
+  Huttenlocher) of n samples spaced by stride, in place. The lower envelope
+  of the parabolas rooted at each sample is built, then sampled back.
+  Scratch needs n floats in tmp and z plus one, and n ints in v
+ */
+static void distance_transform_1d(float* f, int n, int stride, float* tmp, int* v, float* z)
+{
+    for (int q = 0; q < n; ++q)
+        tmp[q] = f[q * stride];
+
+    int k = 0;
+    v[0] = 0;
+    z[0] = -SDF_INF;
+    z[1] = SDF_INF;
+    for (int q = 1; q < n; ++q)
+    {
+        float s;
+        for (;;)
+        {
+            int r = v[k];
+            s = ((tmp[q] + (float)q * q) - (tmp[r] + (float)r * r)) / (2.0f * (q - r));
+            if (s > z[k])
+                break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = SDF_INF;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k + 1] < q)
+            ++k;
+        float d = (float)(q - v[k]);
+        f[q * stride] = d * d + tmp[v[k]];
+    }
+}
+
+/* Squared distance of every sample to the nearest zero sample, separably by columns then rows */
+static void distance_transform(float* f, int w, int h)
+{
+    int n = w > h ? w : h;
+    float* tmp = malloc((2 * n + 1) * sizeof(float));
+    int* v = malloc(n * sizeof(int));
+    for (int x = 0; x < w; ++x)
+        distance_transform_1d(f + x, h, w, tmp, v, tmp + n);
+    for (int y = 0; y < h; ++y)
+        distance_transform_1d(f + (size_t)y * w, w, 1, tmp, v, tmp + n);
+    free(v);
+    free(tmp);
+}
+
+/*
+  Renders the distance field of a glyph measured at the given scale, clipped to w by h texels.
+  Exact distances to the nearest texel of the other side are taken over the
+  glyph's antialiased bitmap, with partially covered texels seeded by their
+  coverage as the subpixel distance to the outline
+ */
+static void render_sdf_glyph(struct font* font, const struct font_glyph_info* gi, float scale, unsigned char* dst, int w, int h, int stride)
+{
+    const int spread = font->sdf_spread;
+    int gw = gi->size.x, gh = gi->size.y;
+    size_t n = (size_t)gw * gh;
+
+    /* Rasterize inside the margin */
+    unsigned char* coverage = calloc(n, 1);
+    stbtt_MakeCodepointBitmap(&font->info, coverage + (size_t)spread * gw + spread, gw - 2 * spread, gh - 2 * spread, gw,
+                              scale, scale, gi->codepoint);
+
+    /* Squared distances to the inside and to the outside */
+    float* to_in = malloc(n * sizeof(float));
+    float* to_out = malloc(n * sizeof(float));
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (coverage[i] == 255)
+        {
+            to_in[i] = 0.0f;
+            to_out[i] = SDF_INF;
+        }
+        else if (coverage[i] == 0)
+        {
+            to_in[i] = SDF_INF;
+            to_out[i] = 0.0f;
+        }
+        else
+        {
+            float d = 0.5f - coverage[i] / 255.0f;
+            to_in[i] = d > 0.0f ? d * d : 0.0f;
+            to_out[i] = d < 0.0f ? d * d : 0.0f;
+        }
+    }
+    distance_transform(to_in, gw, gh);
+    distance_transform(to_out, gw, gh);
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            size_t i = (size_t)y * gw + x;
+            float d = sqrtf(to_out[i]) - sqrtf(to_in[i]);
+            float v = 127.5f + d * 127.5f / spread;
+            dst[(size_t)y * stride + x] = (unsigned char)(v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v + 0.5f);
+        }
+    }
+    free(to_out);
+    free(to_in);
+    free(coverage);
+}
+
+/* Renders the bitmap or distance field of a glyph measured at the given scale, clipped to w by h texels */
+static void render_glyph(struct font* font, const struct font_glyph_info* gi, float scale, unsigned char* dst, int w, int h, int stride)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    if (font->sdf_spread)
+        render_sdf_glyph(font, gi, scale, dst, w, h, stride);
+    else
+        stbtt_MakeCodepointBitmap(&font->info, dst, w, h, stride, scale, scale, gi->codepoint);
+}
+
+/* =------------------------------------------------------------------------= */
+/* Packed glyph rasterization shared by the bake workers */
+struct bake_job
+{
+    struct font* font;
+    mutex_t lock;
+    size_t next;          /* First glyph not claimed yet */
+};
+
+/* Renders the packed glyphs in the given index range to their atlas locations */
+static void bake_glyph_range(struct font* font, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; ++i)
+    {
+        struct font_glyph_info* gi = font->glyphs + i;
+        render_glyph(font, gi, font->scale, font->tex_data + (size_t)gi->offset.y * font->tex_width + gi->offset.x,
+                     gi->size.x, gi->size.y, font->tex_width);
+    }
+}
+
+/* Claims batches of glyphs until none are left */
+static void bake_worker(void* arg)
+{
+    struct bake_job* job = arg;
+    size_t n = job->font->num_glyphs;
+    for (;;)
+    {
+        mutex_lock(job->lock);
+        size_t first = job->next;
+        job->next = first + BAKE_BATCH < n ? first + BAKE_BATCH : n;
+        size_t last = job->next;
+        mutex_unlock(job->lock);
+        if (first == last)
+            return;
+        bake_glyph_range(job->font, first, last);
+    }
+}
+
+/*
+  Renders the packed glyphs to their atlas locations, in batches spread
+  over worker threads and the calling one. Glyph rectangles are disjoint,
+  so the workers never write the same texels and the atlas comes out the
+  same whatever the thread count
+ */
+static void bake_glyphs(struct font* font)
+{
+    int threads = cpu_count();
+    const char* forced = getenv(BAKE_THREADS_ENV);
+    if (forced && *forced)
+    {
+        if (atoi(forced) > 0)
+            threads = atoi(forced);
+        else
+            fprintf(stderr, "Ignoring malformed %s=%s\n", BAKE_THREADS_ENV, forced);
+    }
+    int batches = (int)((font->num_glyphs + BAKE_BATCH - 1) / BAKE_BATCH);
+    if (threads > batches)
+        threads = batches;
+    if (threads <= 1)
+    {
+        bake_glyph_range(font, 0, font->num_glyphs);
+        return;
+    }
+
+    struct bake_job job;
+    job.font = font;
+    job.lock = mutex_create();
+    job.next = 0;
+    thread_t* workers = malloc((threads - 1) * sizeof(thread_t));
+    for (int i = 0; i < threads - 1; ++i)
+        workers[i] = thread_create(bake_worker, &job);
+    /* Failed spawns only leave more batches to the others */
+    bake_worker(&job);
+    for (int i = 0; i < threads - 1; ++i)
+        if (workers[i])
+            thread_join(workers[i]);
+    free(workers);
+    mutex_destroy(job.lock);
+}
+
 /*
-  Parses given font file data to a corresponding font instance.
-  Return value must be freed by the free_font function.
-  This is usually done by the fontstore functions
+  Parses given font file data into a cleared font instance, baking the
+  atlas into its pooled storage. Returns zero if the data is no font
  */
-static font_t parse_font_to_mem_buf(const float pixel_height, const unsigned char* buf, size_t buf_sz)
+static int parse_font_to_mem_buf(struct font* font, const float pixel_height, int sdf_spread, const unsigned char* buf, size_t buf_sz)
 {
     (void) buf_sz;
     /* Default values */
-    const char min_glyph_cp = 32;
-    const char max_glyph_cp = 127;
+    const int min_glyph_cp = 32;
+    const int max_glyph_cp = 127;
     const int num_glyphs = max_glyph_cp - min_glyph_cp;
 
     /*
@@ -74,130 +734,677 @@ static font_t parse_font_to_mem_buf(const float pixel_height, const unsigned cha
 
     /* Prepare fontinfo struct */
     stbtt_fontinfo fi;
-    if(!stbtt_InitFont(&fi, buf, font_off))
+    if (font_off < 0 || !stbtt_InitFont(&fi, buf, font_off))
     {
-        /* TODO: Error handling */
+        fprintf(stderr, "Could not parse font data\n");
+        return 0;
     }
 
     /* Calculate font scaling */
     float scale_factor = stbtt_ScaleForPixelHeight(&fi, pixel_height);
 
-    /* The font stucture to be filled and returned */
-    struct font* font = malloc(sizeof(struct font));
-
-    /* Calculate the texture dimensions that will hold the rasterized data */
-    int x0, y0, x1, y1;
-    stbtt_GetFontBoundingBox(&fi, &x0, &y0, &x1, &y1);
-    font->tex_width = (int)((x1 - x0) * num_glyphs * scale_factor);
-    font->tex_height = (int)((y1 - y0) * scale_factor);
-
-    /* Create the texture data buffer that will hold all the loaded glyphs */
-    font->tex_data = malloc((font->tex_width * font->tex_height) * num_glyphs);
-    memset(font->tex_data, 0, (font->tex_width * font->tex_height) * num_glyphs);
+    /* Fill the font structure */
+    font->info = fi;
+    font->scale = scale_factor;
+    font->pixel_height = pixel_height;
+    font->sdf_spread = sdf_spread;
 
     /* Create the glyph info array */
-    font->glyphs = malloc(num_glyphs * sizeof(struct font_glyph_info));
+    font->glyphs = reserve_pool(&font->glyph_pool, num_glyphs * sizeof(struct font_glyph_info));
     font->num_glyphs = num_glyphs;
     memset(font->glyphs, 0, num_glyphs * sizeof(struct font_glyph_info));
 
     /* Get font ascent and descent */
     int ascent, descent;
     stbtt_GetFontVMetrics(&fi, &ascent, &descent, 0);
-
-    /* Render fonts to single bitmap */
-    int x = 0;
-    for (char c = min_glyph_cp; c < max_glyph_cp; ++c)
+    font->ascent = (int)(ascent * scale_factor);
+    font->line_height = font->ascent - (int)(descent * scale_factor);
+    font->cell_width = 0;
+
+    /* Gather the glyph metrics and the rectangles to pack */
+    stbrp_rect* rects = malloc(num_glyphs * sizeof(stbrp_rect));
+    long area = 0;
+    for (int c = min_glyph_cp; c < max_glyph_cp; ++c)
     {
         /* The glyph info data structure for the current codepoint */
         struct font_glyph_info* glyph_info = font->glyphs + c - min_glyph_cp;
 
-        /* Get bounding box for character */
-        int ix0, iy0, ix1, iy1;
-        stbtt_GetCodepointBitmapBox(&fi, c, scale_factor, scale_factor, &ix0, &iy0, &ix1, &iy1);
+        /* Store glyph info for later rendering */
+        measure_glyph(font, c, font->scale, glyph_info);
+        if (glyph_info->advance > font->cell_width)
+            font->cell_width = (int)glyph_info->advance;
+
+        /* Padding on the far sides only, the atlas border clamps the near ones */
+        stbrp_rect* r = rects + c - min_glyph_cp;
+        r->id = c - min_glyph_cp;
+        r->w = (stbrp_coord)(glyph_info->size.x + ATLAS_PADDING);
+        r->h = (stbrp_coord)(glyph_info->size.y + ATLAS_PADDING);
+        area += (long)r->w * r->h;
+    }
+
+    /*
+     Pack into the smallest power of two atlas that fits, trying the
+     half height rectangle before the square one of each side length
+     */
+    int side = 1;
+    while ((long)side * side < area)
+        side *= 2;
+    int width = side, height = side / 2 > 0 ? side / 2 : 1;
+    stbrp_node* nodes = malloc(sizeof(stbrp_node) * side * 2);
+    for (;;)
+    {
+        if ((long)width * height >= area)
+        {
+            stbrp_context ctx;
+            stbrp_init_target(&ctx, width, height, nodes, width);
+            stbrp_pack_rects(&ctx, rects, num_glyphs);
+            int packed = 1;
+            for (int i = 0; i < num_glyphs && packed; ++i)
+                packed = rects[i].was_packed;
+            if (packed)
+                break;
+        }
+
+        /* Grow height first, then width, alternating */
+        if (height < width)
+            height *= 2;
+        else
+        {
+            width *= 2;
+            nodes = realloc(nodes, sizeof(stbrp_node) * width);
+        }
+    }
+    free(nodes);
+
+    /*
+      Glyph cache grid below the packed glyphs, cells fit the largest glyph of the font.
+      Bitmap boxes round their edges outwards, so they span up to one texel more
+      than the rounded up extent of the bounding box
+     */
+    int x0, y0, x1, y1;
+    stbtt_GetFontBoundingBox(&fi, &x0, &y0, &x1, &y1);
+    font->cell_w = (int)ceilf((x1 - x0) * scale_factor) + 1 + 2 * sdf_spread + ATLAS_PADDING;
+    font->cell_h = (int)ceilf((y1 - y0) * scale_factor) + 1 + 2 * sdf_spread + ATLAS_PADDING;
+    while (width < font->cell_w)
+        width *= 2;
+    font->cache_cols = width / font->cell_w;
+    font->cache_y = 0;
+    for (int i = 0; i < num_glyphs; ++i)
+        if (rects[i].y + rects[i].h > font->cache_y)
+            font->cache_y = rects[i].y + rects[i].h;
+    int cache_rows = (GLYPH_CACHE_CELLS + font->cache_cols - 1) / font->cache_cols;
+    while (height < font->cache_y + cache_rows * font->cell_h)
+        height *= 2;
+
+    /* Use up whatever the power of two height leaves */
+    cache_rows = (height - font->cache_y) / font->cell_h;
+    font->num_cells = (size_t)cache_rows * font->cache_cols;
+    font->cell_used = calloc(font->num_cells, sizeof(unsigned long));
+    font->cell_generation = calloc(font->num_cells, sizeof(unsigned long));
+    font->use_clock = 0;
+    font->glyphs = reserve_pool(&font->glyph_pool, (num_glyphs + font->num_cells) * sizeof(struct font_glyph_info));
+
+    /* Create the texture data buffer that will hold all the loaded glyphs */
+    font->tex_width = width;
+    font->tex_height = height;
+    font->tex_data = reserve_pool(&font->tex_pool, (size_t)width * height);
+    memset(font->tex_data, 0, (size_t)width * height);
+
+    /* Render fonts to their packed locations */
+    for (int i = 0; i < num_glyphs; ++i)
+    {
+        struct font_glyph_info* glyph_info = font->glyphs + rects[i].id;
+        glyph_info->offset.x = rects[i].x;
+        glyph_info->offset.y = rects[i].y;
+    }
+    free(rects);
+    bake_glyphs(font);
+
+    index_glyphs(font);
+    build_kerning_table(font);
+    return 1;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Retrieves glyph info for the given codepoint in the given font, null if it is missing */
+static struct font_glyph_info* get_glyph(struct font* font, int codepoint)
+{
+    if (codepoint >= 0 && codepoint < GLYPH_DIRECT_RANGE)
+    {
+        int index = font->direct[codepoint];
+        return index >= 0 ? font->glyphs + index : 0;
+    }
+    if (font->sparse_count == 0)
+        return 0;
+    for (size_t i = hash_codepoint(codepoint, font->sparse_cap); ; i = (i + 1) & (font->sparse_cap - 1))
+    {
+        if (font->sparse[i].codepoint == codepoint)
+            return font->glyphs + font->sparse[i].index;
+        if (font->sparse[i].codepoint < 0)
+            return 0;
+    }
+}
+
+/* Kerning in pixels between two glyph info indices, zero unless both are packed glyphs */
+static int get_kerning(struct font* font, size_t left, size_t right)
+{
+    if (font->kern_cap == 0 || left >= font->num_glyphs || right >= font->num_glyphs)
+        return 0;
+    unsigned int key = (unsigned int)(left * font->num_glyphs + right);
+    for (size_t i = hash_codepoint((int) key, font->kern_cap); ; i = (i + 1) & (font->kern_cap - 1))
+    {
+        if (font->kerning[i].key == key)
+            return font->kerning[i].amount;
+        if (font->kerning[i].key == KERN_EMPTY)
+            return 0;
+    }
+}
+
+/*
+  Decodes the UTF-8 sequence at *s and advances past it. Malformed,
+  overlong or surrogate sequences decode to U+FFFD a byte at a time
+ */
+static int next_codepoint(const char** s)
+{
+    static const int min_cp[] = { 0, 0x80, 0x800, 0x10000 };
+    const unsigned char* p = (const unsigned char*) *s;
+    int cp, n;
+    if (p[0] < 0x80)
+    {
+        *s += 1;
+        return p[0];
+    }
+    else if ((p[0] & 0xE0) == 0xC0) { cp = p[0] & 0x1F; n = 1; }
+    else if ((p[0] & 0xF0) == 0xE0) { cp = p[0] & 0x0F; n = 2; }
+    else if ((p[0] & 0xF8) == 0xF0) { cp = p[0] & 0x07; n = 3; }
+    else
+    {
+        *s += 1;
+        return 0xFFFD;
+    }
+
+    /* A continuation byte check also stops at the terminator */
+    for (int i = 1; i <= n; ++i)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            *s += 1;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (p[i] & 0x3F);
+    }
+    if (cp < min_cp[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+    {
+        *s += 1;
+        return 0xFFFD;
+    }
+    *s += n + 1;
+    return cp;
+}
+
+/* Counts the codepoints of a UTF-8 string */
+static size_t utf8_length(const char* s)
+{
+    size_t n = 0;
+    while (*s)
+    {
+        next_codepoint(&s);
+        ++n;
+    }
+    return n;
+}
+
+/* Uploads a glyph cache cell from the bitmap to the atlas texture */
+static void upload_cache_cell(struct font* font, int x, int y)
+{
+    GLint alignment, row_length;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glGetIntegerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, font->tex_width);
+
+    glBindTexture(GL_TEXTURE_2D, font->atlas);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, font->cell_w, font->cell_h, GL_RED, GL_UNSIGNED_BYTE,
+                    font->tex_data + (size_t)y * font->tex_width + x);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+/*
+  Rasterizes a glyph missing from the atlas into a free or the least recently
+  used cache cell. Returns null if every cell holds a glyph of the string being drawn
+ */
+static struct font_glyph_info* cache_glyph(struct font* font, int codepoint)
+{
+    if (font->num_cells == 0)
+        return 0;
+
+    /* Free cells have a zero stamp and win right away */
+    size_t cell = 0;
+    for (size_t i = 1; i < font->num_cells && font->cell_used[cell] != 0; ++i)
+        if (font->cell_used[i] < font->cell_used[cell])
+            cell = i;
+    if (font->cell_used[cell] == font->use_clock)
+        return 0;
+
+    /* Evict the previous occupant */
+    struct font_glyph_info* gi = font->glyphs + font->num_glyphs + cell;
+    if (font->cell_used[cell] != 0)
+    {
+        unindex_glyph(font, gi->codepoint);
+        font->cell_generation[cell]++;
+    }
+
+    /*
+      Glyph metrics, glyphs reaching outside the font's bounding box are
+      scaled down until they fit their cell. The advance stays the font's
+     */
+    float scale = font->scale;
+    measure_glyph(font, codepoint, scale, gi);
+    while (gi->size.x > font->cell_w - ATLAS_PADDING || gi->size.y > font->cell_h - ATLAS_PADDING)
+    {
+        float fit_x = (float)(font->cell_w - ATLAS_PADDING) / gi->size.x;
+        float fit_y = (float)(font->cell_h - ATLAS_PADDING) / gi->size.y;
+        scale *= 0.95f * (fit_x < fit_y ? fit_x : fit_y);
+        measure_glyph(font, codepoint, scale, gi);
+    }
+    gi->offset.x = (int)(cell % font->cache_cols) * font->cell_w;
+    gi->offset.y = font->cache_y + (int)(cell / font->cache_cols) * font->cell_h;
+
+    /* Clear the cell and rasterize, then replace only its texels on the GPU */
+    unsigned char* dst = font->tex_data + (size_t)gi->offset.y * font->tex_width + gi->offset.x;
+    for (int y = 0; y < font->cell_h; ++y)
+        memset(dst + (size_t)y * font->tex_width, 0, font->cell_w);
+    render_glyph(font, gi, scale, dst, gi->size.x, gi->size.y, font->tex_width);
+    if (font->atlas)
+        upload_cache_cell(font, gi->offset.x, gi->offset.y);
+
+    font->cell_used[cell] = font->use_clock;
+    index_glyph(font, codepoint, (int)(font->num_glyphs + cell));
+    return gi;
+}
+
+/*
+  Retrieves the glyph of a codepoint, rasterizing it if missing,
+  and marks it used by the string being drawn
+ */
+static struct font_glyph_info* fetch_glyph(struct font* font, int codepoint)
+{
+    struct font_glyph_info* gi = get_glyph(font, codepoint);
+    if (!gi)
+        return cache_glyph(font, codepoint);
+    size_t index = (size_t)(gi - font->glyphs);
+    if (index >= font->num_glyphs)
+        font->cell_used[index - font->num_glyphs] = font->use_clock;
+    return gi;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Number of chars in text * width * height of a glyph cell */
+size_t get_min_buf_size(fontstash_t fs, font_t handle, const char* text)
+{
+    struct font* font = get_font(fs, handle);
+    if (!font)
+        return 0;
+    return (size_t)font->cell_width * font->line_height * utf8_length(text);
+}
+
+/*
+  Rasterizes the coverage of the text in [text, end) into line_height rows of
+  the given width, placing each glyph's box by its metrics from a pen starting
+  at the left edge. Returns the column past the rightmost written texel
+ */
+static int raster_line(struct font* font, const char* text, const char* end, unsigned char* buf, int width)
+{
+    int extent = 0;
+    long pen = 0;
+    size_t prev = (size_t)-1;
+    for (const char* c = text; c < end; )
+    {
+        /* Glyph info for current char */
+        struct font_glyph_info* gi = fetch_glyph(font, next_codepoint(&c));
+        if (!gi)
+            continue;
+        size_t index = (size_t)(gi - font->glyphs);
+        pen += get_kerning(font, prev, index);
+        prev = index;
+
+        /* Place the glyph's box without the field margin, clipped to the destination */
+        int pad = font->sdf_spread;
+        int gw = gi->size.x - 2 * pad, gh = gi->size.y - 2 * pad;
+        int dx = (int) pen + gi->bearing.x + pad;
+        int dy = font->ascent + gi->bearing.y - pad - gh;
+        int x0 = dx < 0 ? -dx : 0;
+        int x1 = gw < width - dx ? gw : width - dx;
+        pen += gi->advance;
+        if (x1 <= x0)
+            continue;
+        if (dx + x1 > extent)
+            extent = dx + x1;
+        for (int y = 0; y < gh; ++y)
+        {
+            if (dy + y < 0 || dy + y >= font->line_height)
+                continue;
+            const unsigned char* src = font->tex_data + (gi->offset.y + pad + y) * font->tex_width + gi->offset.x + pad;
+            unsigned char* dst = buf + (size_t)(dy + y) * width + dx;
+
+            /* Kerned neighbours may overlap, keep the stronger coverage */
+            if (!pad)
+            {
+                merge_coverage_row(dst + x0, src + x0, x1 - x0);
+                continue;
+            }
+
+            /* For distance fields, the coverage of a texel is its distance to the outline plus one half */
+            for (int x = x0; x < x1; ++x)
+            {
+                float cov = (src[x] - 127.5f) * pad / 127.5f + 0.5f;
+                unsigned char v = (unsigned char)(cov <= 0.0f ? 0 : cov >= 1.0f ? 255 : cov * 255.0f + 0.5f);
+                if (v > dst[x])
+                    dst[x] = v;
+            }
+        }
+    }
+    return extent;
+}
 
-        /* Render character */
-        size_t offset = ((int)(ascent * scale_factor) + iy0) * font->tex_width + (x + ix0);
-        stbtt_MakeCodepointBitmap(&fi, font->tex_data + offset, ix1 - ix0, iy1 - iy0, font->tex_width, scale_factor, scale_factor, c);
+void draw_text_mem_buf(fontstash_t fs, font_t handle, const char* text, unsigned char* buf, int* width, int* height)
+{
+    struct font* font = get_font(fs, handle);
+    if (!font)
+    {
+        *width = *height = 0;
+        return;
+    }
 
-        /* Fetch various metrics */
-        int advance, left_side_bearing;
-        stbtt_GetCodepointHMetrics(&fi, c, &advance, &left_side_bearing);
-        int kern = stbtt_GetCodepointKernAdvance(&fi, c, c + 1);
+    /* Destination width, every advance fits in a cell */
+    *width = (int)(font->cell_width * utf8_length(text));
+    /* Destination height */
+    *height = font->line_height;
+    /* Clear destination buffer */
+    memset(buf, 0, get_min_buf_size(fs, handle, text));
 
-        /* Store glyph info for later rendering */
-        glyph_info->codepoint = c;
-        glyph_info->advance = (int)(advance * scale_factor) + (int)(kern * scale_factor);
-        glyph_info->size.x = ix1 - ix0;
-        glyph_info->size.y = iy1 - iy0;
-        glyph_info->bearing.x = (int)(left_side_bearing * scale_factor);
-        glyph_info->bearing.y = iy1;
+    font->use_clock++;
+    raster_line(font, text, text + strlen(text), buf, *width);
+}
 
-        /* Glyph position in font atlas */
-        glyph_info->offset.x = x + ix0;
-        glyph_info->offset.y = (int)(ascent * scale_factor) + iy0;
+void composite_text(fontstash_t fs, font_t handle, const char* text, int x, int y, float r, float g, float b, const struct pixel_buffer* dst)
+{
+    struct font* font = get_font(fs, handle);
+    if (!font)
+        return;
+    blend_row_fn blend = select_blend_kernel(dst->format);
+    size_t pixel_size = dst->format == PIXEL_RGBA8 ? 4 : 4 * sizeof(float);
+    const float color[3] = { r, g, b };
+    unsigned char* mask = 0;
+    size_t mask_size = 0;
+
+    for (const char* line = text; ; line++, y += font->line_height)
+    {
+        const char* end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
 
-        /* Increase x position of the cursor */
-        x += (int)((x1 - x0) * scale_factor);
+        /* Lines fully above or below the frame are not rasterized */
+        if (y + font->line_height > 0 && y < dst->height && end > line)
+        {
+            /* Every advance fits in a cell and every codepoint takes at least a byte */
+            int width = font->cell_width * (int)(end - line);
+            size_t size = (size_t)width * font->line_height;
+            if (size > mask_size)
+            {
+                free(mask);
+                mask = malloc(size);
+                mask_size = size;
+            }
+            memset(mask, 0, size);
+            font->use_clock++;
+            int extent = raster_line(font, line, end, mask, width);
+
+            /* Blend the mask rows clipped to the frame */
+            int x0 = x < 0 ? -x : 0;
+            int x1 = extent < dst->width - x ? extent : dst->width - x;
+            for (int row = 0; row < font->line_height && x1 > x0; ++row)
+            {
+                if (y + row < 0 || y + row >= dst->height)
+                    continue;
+                unsigned char* out = (unsigned char*) dst->pixels + (size_t)(y + row) * dst->stride + (size_t)(x + x0) * pixel_size;
+                blend(out, mask + (size_t)row * width + x0, (size_t)(x1 - x0), color);
+            }
+        }
+        line = end;
+        if (!*line)
+            break;
     }
-    return font;
+    free(mask);
 }
 
 /* =------------------------------------------------------------------------= */
-/* Retrieves glyph info for the given codepoint in the given font */
-static struct font_glyph_info* get_glyph(font_t font, int codepoint)
+/*
+  Hashes every byte of font data. Stored in the baked cache file and only
+  checked when the font file's size or modification time changed, table
+  checksums in the directory are not trusted to cover edited fonts
+ */
+static unsigned long long hash_font_source(const unsigned char* buf, size_t buf_sz)
 {
-    for (size_t i = 0; i < font->num_glyphs; ++i)
-        if (font->glyphs[i].codepoint == codepoint)
-            return font->glyphs + i;
-    return 0;
+    unsigned long long h = hash_bytes(HASH_SEED, &buf_sz, sizeof(buf_sz));
+    return hash_bytes(h, buf, buf_sz);
 }
 
-/* Helper function to assist copying a chunk of a bitmap to another */
-static void copy_subbitmap(unsigned char* dest, unsigned char* src, int dest_width, int dest_height, int dest_stride, int src_stride)
+/*
+  Names font data for the baked cache by its size and table directory, which
+  holds the offset, length and checksum of every table. Reads a few hundred
+  bytes, so an unchanged font file is not paged in just to find its cache file
+ */
+static unsigned long long hash_font_directory(const unsigned char* buf, size_t buf_sz)
 {
-    int i = 0, j = 0;
-    for (i = 0; i < dest_height; ++i)
-        for (j = 0; j < dest_width; ++j)
-            dest[i * dest_stride + j] = *(src + i * src_stride + j);
+    unsigned long long h = hash_bytes(HASH_SEED, &buf_sz, sizeof(buf_sz));
+    if (buf_sz < 12)
+        return h;
+    int offset = stbtt_GetFontOffsetForIndex(buf, 0);
+    if (offset < 0 || (size_t)offset + 12 > buf_sz)
+        return h;
+    size_t dir_sz = 12 + 16 * (size_t)((buf[offset + 4] << 8) | buf[offset + 5]);
+    if (dir_sz > buf_sz - offset)
+        dir_sz = buf_sz - offset;
+    return hash_bytes(h, buf + offset, dir_sz);
 }
-/* =------------------------------------------------------------------------= */
-/* Number of chars in text * width * height of common glyph bounding box in atlas */
-size_t get_min_buf_size(font_t font, const char* text)
+
+/* Builds the path of the cache file of a font file baked at the given size and mode */
+static void baked_font_path(char* buf, size_t sz, unsigned long long directory_hash, float pixel_height, int sdf_spread)
 {
-    size_t char_cnt = strlen(text);
-    int stride = (int)(font->tex_width / font->num_glyphs);
-    return stride * font->tex_height * char_cnt;
+    unsigned long long key = hash_bytes(directory_hash, &pixel_height, sizeof(pixel_height));
+    key = hash_bytes(key, &sdf_spread, sizeof(sdf_spread));
+    snprintf(buf, sz, "%s/font-%016llx.bin", get_cache_dir(0), key);
 }
 
-void draw_text_mem_buf(font_t font, const char* text, unsigned char* buf, int* width, int* height)
+/* Section offsets of a baked font cache file and its total size */
+struct baked_layout
 {
-    /* Character count in given text */
-    size_t char_cnt = strlen(text);
-    /* X distance between two baked fonts in source bitmap */
-    int stride = (int)(font->tex_width / font->num_glyphs);
+    size_t glyphs, kerning, atlas, size;
+};
 
-    /* Destination width */
-    *width = (int)(stride * char_cnt);
-    /* Destination height */
-    *height = font->tex_height;
-    /* Clear destination buffer */
-    memset(buf, 0, stride * font->tex_height * char_cnt);
+static size_t align16(size_t offset)
+{
+    return (offset + 15) & ~(size_t)15;
+}
+
+static void get_baked_layout(const struct baked_header* hdr, struct baked_layout* layout)
+{
+    layout->glyphs = align16(sizeof(struct baked_header));
+    layout->kerning = align16(layout->glyphs + hdr->num_glyphs * sizeof(struct font_glyph_info));
+    layout->atlas = align16(layout->kerning + hdr->kern_cap * sizeof(struct kern_pair));
+    layout->size = layout->atlas + (size_t)hdr->tex_width * hdr->tex_height;
+}
+
+/*
+  Checks that a mapped cache file belongs to the given size and mode and is complete.
+  Whether it belongs to the given font data is checked by valid_baked_source
+ */
+static int valid_baked_font(const unsigned char* view, size_t size, size_t source_size, float pixel_height, int sdf_spread)
+{
+    const struct baked_header* hdr = (const struct baked_header*) view;
+    if (size < sizeof(struct baked_header)
+     || hdr->magic != BAKED_MAGIC
+     || hdr->version != BAKED_VERSION
+     || hdr->glyph_info_size != sizeof(struct font_glyph_info)
+     || hdr->source_size != source_size
+     || hdr->pixel_height != pixel_height
+     || hdr->sdf_spread != sdf_spread)
+        return 0;
+
+    /* Bound the counts before the layout is computed from them */
+    if (hdr->tex_width <= 0 || hdr->tex_width > 32768 || hdr->tex_height <= 0 || hdr->tex_height > 32768
+     || hdr->num_glyphs > (1u << 20) || hdr->num_cells > (1u << 20) || hdr->kern_cap > (1u << 28)
+     || (hdr->kern_cap & (hdr->kern_cap - 1)) != 0 || hdr->cache_cols <= 0)
+        return 0;
+    struct baked_layout layout;
+    get_baked_layout(hdr, &layout);
+    return layout.size == size;
+}
 
-    /* Render letter by letter */
-    for (size_t i = 0; i < char_cnt; ++i)
+/*
+  Checks that a valid cache file was baked from the given font data. A file
+  stamped with the font file's modification time is trusted as is, other ones
+  are checked against the hash of all of the data and restamped on a match
+ */
+static int valid_baked_source(const unsigned char* view, const char* path, const unsigned char* buf, size_t buf_sz,
+                              unsigned long long mtime)
+{
+    const struct baked_header* hdr = (const struct baked_header*) view;
+    if (mtime && hdr->source_mtime == mtime)
+        return 1;
+    if (hdr->source_hash != hash_font_source(buf, buf_sz))
+        return 0;
+    if (mtime)
     {
-        /* Glyph info for current char */
-        struct font_glyph_info* gi = get_glyph(font, text[i]);
+        FILE* f = fopen(path, "r+b");
+        if (f)
+        {
+            if (fseek(f, (long) offsetof(struct baked_header, source_mtime), SEEK_SET) == 0)
+                fwrite(&mtime, sizeof(mtime), 1, f);
+            fclose(f);
+        }
+    }
+    return 1;
+}
+
+/*
+  Loads a font from its baked cache file into a cleared font instance. The bitmap
+  and the kerning map are used in place from the copy on write mapping, so only
+  the pages touched are read in. Returns zero when the file is missing, stale or damaged
+ */
+static int load_baked_font(struct font* font, const char* path, const float pixel_height, int sdf_spread,
+                           const unsigned char* buf, size_t buf_sz, unsigned long long mtime)
+{
+    size_t size;
+    unsigned char* view = map_file(path, &size);
+    if (!view)
+        return 0;
+    stbtt_fontinfo fi;
+    if (!valid_baked_font(view, size, buf_sz, pixel_height, sdf_spread)
+     || !valid_baked_source(view, path, buf, buf_sz, mtime)
+     || !stbtt_InitFont(&fi, buf, stbtt_GetFontOffsetForIndex(buf, 0)))
+    {
+        unmap_file(view, size);
+        return 0;
+    }
+    const struct baked_header* hdr = (const struct baked_header*) view;
+    struct baked_layout layout;
+    get_baked_layout(hdr, &layout);
+
+    font->baked = view;
+    font->baked_size = size;
+    font->tex_data = view + layout.atlas;
+    font->tex_width = hdr->tex_width;
+    font->tex_height = hdr->tex_height;
+    font->ascent = hdr->ascent;
+    font->line_height = hdr->line_height;
+    font->cell_width = hdr->cell_width;
+    font->pixel_height = pixel_height;
+    font->sdf_spread = sdf_spread;
+    font->info = fi;
+    font->scale = stbtt_ScaleForPixelHeight(&fi, pixel_height);
+
+    /* Glyph infos are copied, the cache cells following them change at runtime */
+    font->num_glyphs = hdr->num_glyphs;
+    font->num_cells = hdr->num_cells;
+    font->glyphs = reserve_pool(&font->glyph_pool, (font->num_glyphs + font->num_cells) * sizeof(struct font_glyph_info));
+    memcpy(font->glyphs, view + layout.glyphs, font->num_glyphs * sizeof(struct font_glyph_info));
+    font->cache_y = hdr->cache_y;
+    font->cell_w = hdr->cell_w;
+    font->cell_h = hdr->cell_h;
+    font->cache_cols = hdr->cache_cols;
+    font->cell_used = calloc(font->num_cells, sizeof(unsigned long));
+    font->cell_generation = calloc(font->num_cells, sizeof(unsigned long));
+    font->use_clock = 0;
+
+    font->kern_cap = hdr->kern_cap;
+    font->kerning = hdr->kern_cap ? (struct kern_pair*)(view + layout.kerning) : 0;
+
+    index_glyphs(font);
+    return 1;
+}
 
-        /* Perform copy operation from source to destination bitmap */
-        copy_subbitmap(
-            buf + i * stride,              /* Destination buffer */
-            font->tex_data + gi->offset.x, /* Start of the current source location */
-            stride,                        /* Destination width */
-            font->tex_height,              /* Destination height */
-            (int)(stride * char_cnt),      /* Destination stride */
-            font->tex_width                /* Source stride */
-        );
+/* Writes a freshly baked font to its cache file, before any glyph is cached on demand */
+static void store_baked_font(struct font* font, const char* path, const unsigned char* buf, size_t buf_sz,
+                             unsigned long long mtime)
+{
+    struct baked_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BAKED_MAGIC;
+    hdr.version = BAKED_VERSION;
+    hdr.source_hash = hash_font_source(buf, buf_sz);
+    hdr.source_size = buf_sz;
+    hdr.source_mtime = mtime;
+    hdr.pixel_height = font->pixel_height;
+    hdr.sdf_spread = font->sdf_spread;
+    hdr.glyph_info_size = sizeof(struct font_glyph_info);
+    hdr.ascent = font->ascent;
+    hdr.line_height = font->line_height;
+    hdr.cell_width = font->cell_width;
+    hdr.tex_width = font->tex_width;
+    hdr.tex_height = font->tex_height;
+    hdr.cache_y = font->cache_y;
+    hdr.cell_w = font->cell_w;
+    hdr.cell_h = font->cell_h;
+    hdr.cache_cols = font->cache_cols;
+    hdr.num_cells = (unsigned int) font->num_cells;
+    hdr.num_glyphs = (unsigned int) font->num_glyphs;
+    hdr.kern_cap = (unsigned int) font->kern_cap;
+
+    /* Assemble the file image, padding included */
+    struct baked_layout layout;
+    get_baked_layout(&hdr, &layout);
+    unsigned char* image = calloc(layout.size, 1);
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(image + layout.glyphs, font->glyphs, font->num_glyphs * sizeof(struct font_glyph_info));
+    if (font->kern_cap)
+        memcpy(image + layout.kerning, font->kerning, font->kern_cap * sizeof(struct kern_pair));
+    memcpy(image + layout.atlas, font->tex_data, (size_t)font->tex_width * font->tex_height);
+
+    /* Write to a temporary and rename it in place, so that readers never see partial files */
+    make_dir(get_cache_dir(0));
+    char tmp_path[1040];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "wb");
+    int ok = 0;
+    if (f)
+    {
+        ok = fwrite(image, 1, layout.size, f) == layout.size;
+        ok = fclose(f) == 0 && ok;
+    }
+    free(image);
+#ifdef _WIN32
+    /* rename does not replace existing files on windows */
+    remove(path);
+#endif
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Could not write baked font cache file %s\n", path);
+        remove(tmp_path);
     }
 }
 
@@ -207,66 +1414,152 @@ fontstash_t init_fontstash()
 {
     fontstash_t fs = (fontstash_t) malloc(sizeof(struct fontstash));
     memset(fs, 0, sizeof(struct fontstash));
+    fs->free_slot = FONT_NO_SLOT;
     return fs;
 }
 
 /* Releases also every font stored in the fontstore before killing it */
 void free_fontstash(fontstash_t fs)
 {
-    for (size_t i = 0; i < fs->num_fonts; ++i)
-        free_font(fs->fonts[i]);
+    for (unsigned int i = 0; i < fs->num_slots; ++i)
+    {
+        struct font_slot* slot = fs->slots + i;
+        if (slot->used)
+            release_font(slot->font);
+        if (slot->font)
+            destroy_font(slot->font);
+    }
+    free(fs->slots);
+    destroy_text_pipeline(&fs->pipeline);
     free(fs);
 }
 
-/* Simple vector resize and append */
-font_t load_font(fontstash_t fs, const float pixel_height, const unsigned char* buf, size_t buf_sz)
+/* Resolves a handle to its font, null for handles of unloaded fonts */
+static struct font* get_font(fontstash_t fs, font_t handle)
 {
-    (void) buf_sz;
+    unsigned int index = handle & FONT_INDEX_MASK;
+    if (index >= fs->num_slots)
+        return 0;
+    struct font_slot* slot = fs->slots + index;
+    if (!slot->used || slot->generation != handle >> FONT_INDEX_BITS)
+        return 0;
+    return slot->font;
+}
 
-    /* Allocate space for new font */
-    fs->num_fonts++;
-    font_t* new_fonts = malloc(fs->num_fonts * sizeof(font_t));
-    if (fs->fonts)
+/* Takes a slot off the free list, or a fresh one. Returns FONT_NO_SLOT when every index is taken */
+static unsigned int acquire_slot(fontstash_t fs)
+{
+    unsigned int index = fs->free_slot;
+    if (index != FONT_NO_SLOT)
     {
-        memcpy(new_fonts, fs->fonts, fs->num_fonts * sizeof(font_t));
-        free(fs->fonts);
+        fs->free_slot = fs->slots[index].next_free;
+        return index;
     }
-    fs->fonts = new_fonts;
+    if (fs->num_slots == FONT_MAX_SLOTS)
+        return FONT_NO_SLOT;
 
-    /* Append new font */
-    font_t font = parse_font_to_mem_buf(pixel_height, buf, buf_sz);
-    fs->fonts[fs->num_fonts - 1] = font;
+    /* Grow geometrically, slots only hold pointers so moving them is fine */
+    if (fs->num_slots == fs->slot_cap)
+    {
+        fs->slot_cap = fs->slot_cap ? fs->slot_cap * 2 : 8;
+        fs->slots = realloc(fs->slots, fs->slot_cap * sizeof(struct font_slot));
+    }
+    index = fs->num_slots++;
+    memset(fs->slots + index, 0, sizeof(struct font_slot));
+    fs->slots[index].generation = 1;
+    return index;
+}
 
-    return font;
+/* Puts a slot back on the free list, invalidating the handles given out for it */
+static void free_slot(fontstash_t fs, unsigned int index)
+{
+    struct font_slot* slot = fs->slots + index;
+    slot->used = 0;
+    slot->generation = (slot->generation + 1) & (0xFFFFFFFFu >> FONT_INDEX_BITS);
+    if (slot->generation == 0)
+        slot->generation = 1;
+    slot->next_free = fs->free_slot;
+    fs->free_slot = index;
 }
 
-/* Simple vector remove */
-void unload_font(fontstash_t fs, font_t font)
+/* Loads a font into a free slot, reusing the storage of the font that held it before */
+static font_t add_font(fontstash_t fs, const float pixel_height, int sdf_spread, const unsigned char* buf, size_t buf_sz,
+                       unsigned long long mtime)
 {
-    for (size_t i = 0; i < fs->num_fonts; ++i)
+    unsigned int index = acquire_slot(fs);
+    if (index == FONT_NO_SLOT)
     {
-        if (fs->fonts[i] == font)
+        fprintf(stderr, "Could not load font, all %u font slots are in use\n", FONT_MAX_SLOTS);
+        return 0;
+    }
+    struct font_slot* slot = fs->slots + index;
+    if (!slot->font)
+        slot->font = calloc(1, sizeof(struct font));
+    else
+        reset_font(slot->font);
+    struct font* font = slot->font;
+
+    /* Reuse the atlas baked by an earlier run, baking and caching it otherwise */
+    if (fs->no_disk_cache)
+    {
+        if (!parse_font_to_mem_buf(font, pixel_height, sdf_spread, buf, buf_sz))
+        {
+            free_slot(fs, index);
+            return 0;
+        }
+    }
+    else
+    {
+        char path[1024];
+        baked_font_path(path, sizeof(path), hash_font_directory(buf, buf_sz), pixel_height, sdf_spread);
+        if (!load_baked_font(font, path, pixel_height, sdf_spread, buf, buf_sz, mtime))
         {
-            /* Free removed font */
-            free_font(font);
+            reset_font(font);
+            if (!parse_font_to_mem_buf(font, pixel_height, sdf_spread, buf, buf_sz))
+            {
+                free_slot(fs, index);
+                return 0;
+            }
+            store_baked_font(font, path, buf, buf_sz, mtime);
+        }
+    }
+
+    slot->used = 1;
+    fs->num_fonts++;
+    return (slot->generation << FONT_INDEX_BITS) | index;
+}
 
-            /* Alloc new fonts array */
-            fs->num_fonts--;
-            font_t* new_fonts = malloc(fs->num_fonts * sizeof(font_t));
+font_t load_font(fontstash_t fs, const float pixel_height, const unsigned char* buf, size_t buf_sz)
+{
+    return add_font(fs, pixel_height, 0, buf, buf_sz, 0);
+}
 
-            /* Copy up to the found element from previous to new array */
-            memcpy(new_fonts, fs->fonts, i * sizeof(font_t));
+font_t load_font_stamped(fontstash_t fs, const float pixel_height, const unsigned char* buf, size_t buf_sz, unsigned long long mtime)
+{
+    return add_font(fs, pixel_height, 0, buf, buf_sz, mtime);
+}
 
-            /* Copy the rest elements from the previous to new array */
-            memcpy(new_fonts + i, fs->fonts + i + 1, i * sizeof(font_t));
+font_t load_sdf_font(fontstash_t fs, const unsigned char* buf, size_t buf_sz)
+{
+    return add_font(fs, SDF_BASE_HEIGHT, SDF_SPREAD, buf, buf_sz, 0);
+}
 
-            /* Replace previous font array with new one */
-            free(fs->fonts);
-            fs->fonts = new_fonts;
+void enable_font_cache(fontstash_t fs, int enable)
+{
+    fs->no_disk_cache = !enable;
+}
 
-            break;
-        }
-    }
+void unload_font(fontstash_t fs, font_t handle)
+{
+    struct font* font = get_font(fs, handle);
+    if (!font)
+        return;
+
+    /* Free removed font and its layouts, keeping its storage pooled in the slot */
+    forget_text_layouts(&fs->pipeline, font);
+    release_font(font);
+    free_slot(fs, handle & FONT_INDEX_MASK);
+    fs->num_fonts--;
 }
 /* =------------------------------------------------------------------------= */
 /* Vertex shader for text rendering */
@@ -276,11 +1569,12 @@ layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex> \n\
 out vec2 TexCoords;                                           \n\
                                                               \n\
 uniform mat4 projection;                                      \n\
+uniform vec2 offset;                                          \n\
                                                               \n\
 void main()                                                   \n\
 {                                                             \n\
     TexCoords = vertex.zw;                                    \n\
-    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);     \n\
+    gl_Position = projection * vec4(vertex.xy + offset, 0.0, 1.0); \n\
 }                                                             \n\
 ";
 
@@ -300,183 +1594,462 @@ void main()                                                          \n\
 }                                                                    \n\
 ";
 
-struct text_color
-{
-    float r, g, b;
-};
+/*
+  Fragment shader for distance field text. The outline sits at 0.5 and
+  the edge is antialiased over the field's change across one pixel,
+  which keeps it a pixel wide at any scale
+ */
+static const char* text_sdf_frag_src = "                             \n\
+#version 330 core                                                    \n\
+in vec2 TexCoords;                                                   \n\
+out vec4 color;                                                      \n\
+                                                                     \n\
+uniform sampler2D text;                                              \n\
+uniform vec3 textColor;                                              \n\
+                                                                     \n\
+void main()                                                          \n\
+{                                                                    \n\
+    float dist = texture(text, TexCoords).r;                         \n\
+    float edge = max(0.5 * fwidth(dist), 1e-4);                      \n\
+    float alpha = smoothstep(0.5 - edge, 0.5 + edge, dist);          \n\
+    color = vec4(textColor, alpha);                                  \n\
+}                                                                    \n\
+";
 
-struct render_text_context
+static int create_text_program(struct text_program* tprog, const char* frag_src)
 {
-    GLuint shader_program;
-    GLuint vao;
-    GLuint vbo;
-    GLuint glyph_texture_atlas;
-};
+    tprog->program = build_program(text_vertex_src, frag_src);
+    if (!tprog->program)
+        return 0;
+    tprog->projection_loc = glGetUniformLocation(tprog->program, "projection");
+    tprog->offset_loc = glGetUniformLocation(tprog->program, "offset");
+    tprog->color_loc = glGetUniformLocation(tprog->program, "textColor");
+    tprog->sampler_loc = glGetUniformLocation(tprog->program, "text");
+    glUseProgram(tprog->program);
+    glUniform1i(tprog->sampler_loc, 0);
+    glUseProgram(0);
+    return 1;
+}
 
-static void render_text(struct render_text_context* rtc, font_t font, const char* string, float x, float y, struct text_color col)
+/* Creates the shared text draw objects */
+static int create_text_pipeline(struct text_pipeline* tp)
 {
-    /* Store previous blending state */
-    GLboolean blend = glIsEnabled(GL_BLEND);
-
-    /* Store previous src alpha blend function */
-    GLint srcAlphaBlendFunc;
-    glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlphaBlendFunc);
+    if (!create_text_program(&tp->coverage, text_frag_src))
+        return 0;
+    if (!create_text_program(&tp->sdf, text_sdf_frag_src))
+    {
+        glDeleteProgram(tp->coverage.program);
+        tp->coverage.program = 0;
+        return 0;
+    }
+    gen_gl_buffers(1, &tp->ebo);
+    return 1;
+}
 
-    /* Enable blending */
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+static void destroy_text_pipeline(struct text_pipeline* tp)
+{
+    if (!tp->ebo)
+        return;
+    for (size_t i = 0; i <= LAYOUT_CACHE_SIZE; ++i)
+    {
+        struct text_layout* tl = i < LAYOUT_CACHE_SIZE ? tp->layouts + i : &tp->transient;
+        if (!tl->vao)
+            continue;
+        glDeleteVertexArrays(1, &tl->vao);
+        glDeleteBuffers(1, &tl->vbo);
+        free(tl->string);
+        free(tl->cells);
+    }
+    glDeleteProgram(tp->coverage.program);
+    glDeleteProgram(tp->sdf.program);
+    glDeleteBuffers(1, &tp->ebo);
+    free(tp->vertices);
+    memset(tp, 0, sizeof(*tp));
+}
 
-    /* Setup program params */
-    mat4x4 projection;
-    mat4_ortho(0.0f, 800, 0.0f, 600, projection);
-    glUseProgram(rtc->shader_program);
-    glUniformMatrix4fv(glGetUniformLocation(rtc->shader_program, "projection"), 1, GL_FALSE, (float*)projection);
-    glUniform3f(glGetUniformLocation(rtc->shader_program, "textColor"), col.r, col.g, col.b);
-    glUniform1i(glGetUniformLocation(rtc->shader_program, "text"), 0);
+/* Grows the pipeline's buffers to hold the given number of quads, a vao holding the ebo must be bound */
+static void reserve_text_quads(struct text_pipeline* tp, size_t num_quads)
+{
+    if (num_quads <= tp->max_quads)
+        return;
 
-    /* Bind texture atlas */
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, rtc->glyph_texture_atlas);
-
-    /* Iterate through all input characters */
-    float cur_x = x;
-    size_t text_len = strlen(string);
-    for (size_t i = 0; i < text_len; ++i)
-    {
-        const char c = string[i];
-        struct font_glyph_info* glyph = get_glyph(font, c);
-
-        /* Baseline position */
-        GLfloat x_pos = cur_x;
-        GLfloat y_pos = y - glyph->bearing.y;
-
-        /* Glyph size */
-        GLfloat width = (GLfloat)glyph->size.x;
-        GLfloat height = (GLfloat)glyph->size.y;
-
-        /* Upper left point of glyph region in atlas texture */
-        GLfloat atlas_xoffset = (GLfloat)glyph->offset.x;
-        GLfloat atlas_yoffset = (GLfloat)glyph->offset.y;
-
-        GLfloat vertices[4][4];
-        /* Upper left */
-        vertices[0][0] = x_pos;
-        vertices[0][1] = y_pos + height;
-        vertices[0][2] = atlas_xoffset / font->tex_width;
-        vertices[0][3] = atlas_yoffset / font->tex_height;
-        /* Lower left */
-        vertices[1][0] = x_pos;
-        vertices[1][1] = y_pos;
-        vertices[1][2] = atlas_xoffset / font->tex_width;
-        vertices[1][3] = (atlas_yoffset + height) / font->tex_height;
-        /* Upper right */
-        vertices[2][0] = x_pos + width;
-        vertices[2][1] = y_pos + height;
-        vertices[2][2] = (atlas_xoffset + width) / font->tex_width;
-        vertices[2][3] = atlas_yoffset / font->tex_height;
-        /* Lower right */
-        vertices[3][0] = x_pos + width;
-        vertices[3][1] = y_pos;
-        vertices[3][2] = (atlas_xoffset + width) / font->tex_width;
-        vertices[3][3] = (atlas_yoffset + height) / font->tex_height;
-
-        /* Render glyph texture over quad */
-        glBindBuffer(GL_ARRAY_BUFFER, rtc->vbo);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 4 * 4 * sizeof(GLfloat), vertices);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    /* Round up to limit reallocations of a slowly growing text */
+    size_t cap = tp->max_quads ? tp->max_quads : 64;
+    while (cap < num_quads)
+        cap *= 2;
 
-        /* Advance cursor for next glyph */
-        cur_x += glyph->advance;
+    /* Indices never change, two triangles sharing each quad's diagonal */
+    GLuint* indices = malloc(cap * 6 * sizeof(GLuint));
+    for (GLuint i = 0; i < cap; ++i)
+    {
+        GLuint* idx = indices + i * 6;
+        idx[0] = i * 4 + 0; idx[1] = i * 4 + 1; idx[2] = i * 4 + 2;
+        idx[3] = i * 4 + 2; idx[4] = i * 4 + 1; idx[5] = i * 4 + 3;
     }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, cap * 6 * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    free(indices);
 
-    glBindVertexArray(rtc->vao);
-
-    glBindVertexArray(0);
-    glUseProgram(0);
-
-    /* Restore blending options */
-    glBlendFunc(GL_SRC_ALPHA, srcAlphaBlendFunc);
-    if(blend)
-        glEnable(GL_BLEND);
-    else
-        glDisable(GL_BLEND);
+    free(tp->vertices);
+    tp->vertices = malloc(cap * 4 * 4 * sizeof(GLfloat));
+    tp->max_quads = cap;
 }
 
-void draw_text(fontstash_t fs, font_t font, const char* string, float x, float y, float r, float g, float b)
-{
-    (void) fs;
-    struct render_text_context rtc;
-
-    /* Compile vertex shader */
-    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader, 1, &text_vertex_src, 0);
-    glCompileShader(vert_shader);
-
-    /* Compile fragment shader */
-    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader, 1, &text_frag_src, 0);
-    glCompileShader(frag_shader);
-
-    /* Link shader program */
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vert_shader);
-    glAttachShader(shader_program, frag_shader);
-    glLinkProgram(shader_program);
-    glDeleteShader(vert_shader);
-    glDeleteShader(frag_shader);
-    rtc.shader_program = shader_program;
-
-    /* Setup vbo */
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    /* 2D quad (line strip) needs 4 vertices * 4 floats each (2 for pos + 2 for texCoords) */
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * 4, 0, GL_DYNAMIC_DRAW);
-    rtc.vbo = vbo;
-
-    /* Setup vao */
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-    glEnableVertexAttribArray(0);
-    rtc.vao = vao;
-
+/* Uploads the font's bitmap to its atlas texture */
+static void upload_font_atlas(struct font* font)
+{
     /* Store current unpack alignment */
     GLint pixelStoreAlignment;
     glGetIntegerv(GL_UNPACK_ALIGNMENT, &pixelStoreAlignment);
     /* Disable 4 byte alignment because we use one byte per pixel */
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    /* Setup texture atlas */
-    GLuint glyph_atlas;
-    glGenTextures(1, &glyph_atlas);
-    glBindTexture(GL_TEXTURE_2D, glyph_atlas);
+    /* Respecify the texture of the slot's previous font if there is one */
+    if (font->atlas_pool)
+    {
+        font->atlas = font->atlas_pool;
+        font->atlas_pool = 0;
+    }
+    else
+        gen_gl_textures(1, &font->atlas);
+    glBindTexture(GL_TEXTURE_2D, font->atlas);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, font->tex_width, font->tex_height, 0, GL_RED, GL_UNSIGNED_BYTE, font->tex_data);
-    rtc.glyph_texture_atlas = glyph_atlas;
+    glBindTexture(GL_TEXTURE_2D, 0);
 
     /* Re-enable byte alignment */
     glPixelStorei(GL_UNPACK_ALIGNMENT, pixelStoreAlignment);
+}
+
+/*
+  Fills the given buffer with four <pos, tex> vertices per visible glyph of the
+  string, in triangle strip order, relative to the baseline origin of its first
+  line. Lines break at newlines and, given a positive wrap width, before the
+  word that would cross it, or inside words wider than a whole line. Glyphs
+  are fetched under the current use_clock. Returns the number of quads
+ */
+static size_t layout_text(struct font* font, const char* string, float scale, float wrap_width, GLfloat* out)
+{
+    size_t num_quads = 0;
+    float pen = 0.0f, baseline = 0.0f;
+    size_t prev = (size_t)-1;
+    int line_empty = 1;             /* Non zero until a visible glyph lands on the line */
+    const char* word = 0;           /* Start of the line's last word, after a space */
+    size_t word_quads = 0;          /* Quads of the line preceding that word */
+
+    for (const char* c = string; *c; )
+    {
+        const char* at = c;
+        int codepoint = next_codepoint(&c);
+        if (codepoint == '\n')
+        {
+            pen = 0.0f;
+            baseline -= font->line_height * scale;
+            prev = (size_t)-1;
+            line_empty = 1;
+            word = 0;
+            continue;
+        }
+        struct font_glyph_info* glyph = fetch_glyph(font, codepoint);
+        if (!glyph)
+            continue;
 
-    /* Render */
-    struct text_color col;
-    col.r = r;
-    col.g = g;
-    col.b = b;
-    render_text(&rtc, font, string, x, y, col);
+        /* Pair kerning with the previous glyph */
+        size_t index = (size_t)(glyph - font->glyphs);
+        float kern = get_kerning(font, prev, index) * scale;
+        float advance = glyph->advance * scale;
 
-    /* Release resources */
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteTextures(1, &glyph_atlas);
+        /* Spaces never wrap, they mark where the next word starts */
+        if (codepoint == ' ')
+        {
+            pen += kern + advance;
+            prev = index;
+            word = c;
+            word_quads = num_quads;
+            continue;
+        }
+
+        /* Move the crossing word to a new line, or break it when it fills the line alone */
+        if (wrap_width > 0.0f && !line_empty && pen + kern + advance > wrap_width)
+        {
+            if (word)
+            {
+                num_quads = word_quads;
+                c = word;
+            }
+            else
+                c = at;
+            pen = 0.0f;
+            baseline -= font->line_height * scale;
+            prev = (size_t)-1;
+            line_empty = 1;
+            word = 0;
+            continue;
+        }
+        pen += kern;
+        prev = index;
+        line_empty = 0;
+
+        if (glyph->size.x > 0 && glyph->size.y > 0)
+        {
+            /* Glyph box relative to the pen position */
+            GLfloat x_pos = pen + glyph->bearing.x * scale;
+            GLfloat y_pos = baseline - glyph->bearing.y * scale;
+            GLfloat width = glyph->size.x * scale;
+            GLfloat height = glyph->size.y * scale;
+
+            /* Glyph region in atlas texture */
+            GLfloat u0 = (GLfloat)glyph->offset.x / font->tex_width;
+            GLfloat v0 = (GLfloat)glyph->offset.y / font->tex_height;
+            GLfloat u1 = (GLfloat)(glyph->offset.x + glyph->size.x) / font->tex_width;
+            GLfloat v1 = (GLfloat)(glyph->offset.y + glyph->size.y) / font->tex_height;
+
+            GLfloat (*v)[4] = (GLfloat(*)[4])(out + num_quads * 16);
+            /* Upper left */
+            v[0][0] = x_pos;         v[0][1] = y_pos + height; v[0][2] = u0; v[0][3] = v0;
+            /* Lower left */
+            v[1][0] = x_pos;         v[1][1] = y_pos;          v[1][2] = u0; v[1][3] = v1;
+            /* Upper right */
+            v[2][0] = x_pos + width; v[2][1] = y_pos + height; v[2][2] = u1; v[2][3] = v0;
+            /* Lower right */
+            v[3][0] = x_pos + width; v[3][1] = y_pos;          v[3][2] = u1; v[3][3] = v1;
+            ++num_quads;
+        }
+
+        /* Advance cursor for next glyph */
+        pen += advance;
+    }
+    return num_quads;
+}
+
+/* Frees the layouts of a font, keeping their GL objects for reuse */
+static void forget_text_layouts(struct text_pipeline* tp, struct font* font)
+{
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i)
+    {
+        struct text_layout* tl = tp->layouts + i;
+        if (tl->font != font)
+            continue;
+        free(tl->string);
+        tl->string = 0;
+        tl->font = 0;
+    }
+}
+
+/* Lays the string out into the entry and uploads its quads, the entry's key is left to the caller */
+static void build_text_layout(struct text_pipeline* tp, struct text_layout* tl, struct font* font, const char* string, float pixel_height, float wrap_width)
+{
+    if (!tl->vao)
+    {
+        /* Each glyph quad needs 4 vertices * 4 floats each (2 for pos + 2 for texCoords) */
+        gen_gl_vertex_arrays(1, &tl->vao);
+        gen_gl_buffers(1, &tl->vbo);
+        glBindVertexArray(tl->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, tl->vbo);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tp->ebo);
+    }
+    else
+    {
+        glBindVertexArray(tl->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, tl->vbo);
+    }
+
+    /* Build every glyph's quad, rasterizing missing glyphs into the atlas */
+    reserve_text_quads(tp, strlen(string));
+    font->use_clock++;
+    tl->num_quads = layout_text(font, string, pixel_height / font->pixel_height, wrap_width, tp->vertices);
+    glBufferData(GL_ARRAY_BUFFER, tl->num_quads * 4 * 4 * sizeof(GLfloat), tp->vertices, GL_DYNAMIC_DRAW);
+
+    /* The cells stamped by this layout are the ones its quads point into */
+    tl->num_cells = 0;
+    for (size_t i = 0; i < font->num_cells; ++i)
+    {
+        if (font->cell_used[i] != font->use_clock)
+            continue;
+        if (tl->num_cells == tl->cells_cap)
+        {
+            tl->cells_cap = tl->cells_cap ? tl->cells_cap * 2 : 16;
+            tl->cells = realloc(tl->cells, tl->cells_cap * sizeof(struct layout_cell));
+        }
+        tl->cells[tl->num_cells].cell = i;
+        tl->cells[tl->num_cells].generation = font->cell_generation[i];
+        tl->num_cells++;
+    }
+    tl->font = font;
+    tl->pixel_height = pixel_height;
+    tl->wrap_width = wrap_width;
+}
+
+/*
+  Marks the cells of a cached layout used by the string being drawn, so that
+  they are evicted no sooner than glyphs drawn as recently. Returns zero if one
+  of them was evicted since the layout was built, its glyph may have moved
+ */
+static int touch_layout_cells(struct font* font, struct text_layout* tl)
+{
+    font->use_clock++;
+    for (size_t i = 0; i < tl->num_cells; ++i)
+    {
+        size_t cell = tl->cells[i].cell;
+        if (font->cell_generation[cell] != tl->cells[i].generation)
+            return 0;
+        font->cell_used[cell] = font->use_clock;
+    }
+    return 1;
+}
+
+/*
+  Checks whether a string missing from the cache was drawn recently, remembering
+  it otherwise. Only strings drawn again are worth a cache entry
+ */
+static int seen_text(struct text_pipeline* tp, unsigned long long hash)
+{
+    for (size_t i = 0; i < LAYOUT_SEEN_SIZE; ++i)
+        if (tp->seen[i] == hash)
+            return 1;
+    tp->seen[tp->seen_next] = hash;
+    tp->seen_next = (tp->seen_next + 1) % LAYOUT_SEEN_SIZE;
+    return 0;
+}
+
+/*
+  Picks the entry a newly cached string replaces. Entries holding GL objects
+  are reused before new ones get created: free ones first, then the least
+  recently drawn one if it was not drawn in the last LAYOUT_CACHE_SIZE draws,
+  which no longer belongs to the text drawn every frame. The cache only grows
+  past that working set while every entry is still in it
+ */
+static struct text_layout* choose_text_layout(struct text_pipeline* tp)
+{
+    struct text_layout* lru = 0;
+    struct text_layout* unused = 0;
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i)
+    {
+        struct text_layout* tl = tp->layouts + i;
+        if (!tl->font && tl->vao)
+            return tl;
+        if (!tl->font && !unused)
+            unused = tl;
+        if (tl->font && (!lru || tl->last_used < lru->last_used))
+            lru = tl;
+    }
+    if (lru && (!unused || tp->draw_clock - lru->last_used > LAYOUT_CACHE_SIZE))
+        return lru;
+    return unused;
+}
+
+/*
+  Finds the layout of a string, laying it out again when glyph cache evictions
+  may have moved its glyphs. Strings drawn for the first time are laid out into
+  the transient entry, strings drawn again into the entry chosen by
+  choose_text_layout. Leaves the layout's vao bound
+ */
+static struct text_layout* fetch_text_layout(struct text_pipeline* tp, struct font* font, const char* string, float pixel_height, float wrap_width)
+{
+    unsigned long long hash = hash_bytes(HASH_SEED, string, strlen(string));
+    for (size_t i = 0; i < LAYOUT_CACHE_SIZE; ++i)
+    {
+        struct text_layout* tl = tp->layouts + i;
+        if (tl->font == font
+         && tl->hash == hash
+         && tl->pixel_height == pixel_height
+         && tl->wrap_width == wrap_width
+         && strcmp(tl->string, string) == 0)
+        {
+            if (touch_layout_cells(font, tl))
+                glBindVertexArray(tl->vao);
+            else
+                build_text_layout(tp, tl, font, tl->string, pixel_height, wrap_width);
+            tl->last_used = tp->draw_clock;
+            return tl;
+        }
+    }
+
+    /* Text changing every draw stays out of the cache, sharing the transient GL objects */
+    if (!seen_text(tp, hash))
+    {
+        build_text_layout(tp, &tp->transient, font, string, pixel_height, wrap_width);
+        return &tp->transient;
+    }
+
+    struct text_layout* lru = choose_text_layout(tp);
+    build_text_layout(tp, lru, font, string, pixel_height, wrap_width);
+    size_t len = strlen(string);
+    free(lru->string);
+    lru->string = malloc(len + 1);
+    memcpy(lru->string, string, len + 1);
+    lru->hash = hash;
+    lru->last_used = tp->draw_clock;
+    return lru;
+}
+
+void draw_text(fontstash_t fs, font_t handle, const char* string, float x, float y, float r, float g, float b)
+{
+    struct font* font = get_font(fs, handle);
+    if (font)
+        draw_text_scaled(fs, handle, string, x, y, font->pixel_height, r, g, b);
+}
+
+void draw_text_scaled(fontstash_t fs, font_t handle, const char* string, float x, float y, float pixel_height, float r, float g, float b)
+{
+    draw_text_wrapped(fs, handle, string, x, y, pixel_height, 0.0f, r, g, b);
+}
+
+void draw_text_wrapped(fontstash_t fs, font_t handle, const char* string, float x, float y, float pixel_height, float wrap_width, float r, float g, float b)
+{
+    struct font* font = get_font(fs, handle);
+    if (!font)
+        return;
+    struct text_pipeline* tp = &fs->pipeline;
+    if (!tp->ebo && !create_text_pipeline(tp))
+        return;
+    struct text_program* tprog = font->sdf_spread ? &tp->sdf : &tp->coverage;
+    if (!font->atlas)
+        upload_font_atlas(font);
+
+    /* Store previous blending state */
+    GLboolean blend = glIsEnabled(GL_BLEND);
+
+    /* Store previous src alpha blend function */
+    GLint srcAlphaBlendFunc;
+    glGetIntegerv(GL_BLEND_SRC_ALPHA, &srcAlphaBlendFunc);
+
+    /* Enable blending */
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    /* Setup program params */
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    mat4x4 projection;
+    mat4_ortho(0.0f, (float)viewport[2], 0.0f, (float)viewport[3], projection);
+    glUseProgram(tprog->program);
+    glUniformMatrix4fv(tprog->projection_loc, 1, GL_FALSE, (float*)projection);
+    glUniform2f(tprog->offset_loc, x, y);
+    glUniform3f(tprog->color_loc, r, g, b);
+
+    /* Reuse the string's quads, only laying it out when it changed */
+    tp->draw_clock++;
+    struct text_layout* tl = fetch_text_layout(tp, font, string, pixel_height, wrap_width);
+
+    /* Bind texture atlas */
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, font->atlas);
+
+    glDrawElements(GL_TRIANGLES, (GLsizei)(tl->num_quads * 6), GL_UNSIGNED_INT, 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &vbo);
     glBindVertexArray(0);
-    glDeleteVertexArrays(1, &vao);
+    glBindTexture(GL_TEXTURE_2D, 0);
     glUseProgram(0);
-    glDeleteProgram(shader_program);
+
+    /* Restore blending options */
+    glBlendFunc(GL_SRC_ALPHA, srcAlphaBlendFunc);
+    if(blend)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
 }
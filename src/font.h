@@ -33,23 +33,53 @@
 
 #include "vecmath.h"
 #include "glad/glad.h"
+#include "blend.h"
 
 /* Opaque datatype that holds loaded fonts */
 typedef struct fontstash* fontstash_t;
-/* Opaque datatype that represents a loaded font */
-typedef struct font* font_t;
+/*
+  Handle of a font loaded into a fontstash, zero is never a valid one. Handles
+  of unloaded fonts are rejected, drawing with them does nothing
+ */
+typedef unsigned int font_t;
 
 /* Constructs a fontstash instance */
 fontstash_t init_fontstash();
 /* Deallocates a fontstash instance resources */
 void free_fontstash(fontstash_t);
-/* Loads a font from given memory buffer into the fontstash */
+/*
+  Loads a font from given memory buffer into the fontstash. Printable ASCII
+  is baked right away, other codepoints are rasterized from the buffer when
+  first drawn, so it must stay valid until the font is unloaded. Baked fonts
+  are cached on disk per font data and size, later loads map the cache file
+  instead of rasterizing again. Returns zero if the data is no font
+ */
 font_t load_font(fontstash_t fs, const float pixel_height, const unsigned char* buf, size_t buf_sz);
-/* Unloads the given font from the fontstash */
+/*
+  Same as load_font for data read from a file with the given modification
+  time, see get_file_mtime. While the file keeps its size and time, the baked
+  cache is used without hashing all of the font data again. Zero means unknown
+ */
+font_t load_font_stamped(fontstash_t fs, const float pixel_height, const unsigned char* buf, size_t buf_sz, unsigned long long mtime);
+/*
+  Loads a font as signed distance fields instead of coverage bitmaps, baked once
+  at a fixed base size. draw_text_scaled renders it crisply at any pixel height,
+  so a single small atlas serves every size. Same buffer lifetime as load_font
+ */
+font_t load_sdf_font(fontstash_t fs, const unsigned char* buf, size_t buf_sz);
+/*
+  Enables or disables the baked font cache for later loads, enabled by default.
+  Without it every load rasterizes its glyphs, e.g. to time baking
+ */
+void enable_font_cache(fontstash_t fs, int enable);
+/*
+  Unloads the given font from the fontstash. Its storage stays with the
+  fontstash and is reused by a later load
+ */
 void unload_font(fontstash_t fs, font_t font);
 
-/* Returns the minimum size of memory buffer needed to render the given sentence with the given font */
-size_t get_min_buf_size(font_t font, const char* text);
+/* Returns the minimum size of memory buffer needed to render the given UTF-8 sentence with the given font */
+size_t get_min_buf_size(fontstash_t fs, font_t font, const char* text);
 
 /*
   Renders text with the given font to a preallocated memory bitmap.
@@ -58,33 +88,54 @@ size_t get_min_buf_size(font_t font, const char* text);
 
 Sample:
     // Load font data
-    const char* fontfile = "ext/visitor.ttf";
-    long int fontfile_sz = get_filesize(fontfile);
-    unsigned char* font_data_buf = malloc(fontfile_sz);
-    read_file_to_mem(fontfile, font_data_buf, fontfile_sz);
+    struct asset_view fontfile;
+    open_asset("ext/visitor.ttf", ASSET_ACCESS_RANDOM, &fontfile);
 
     // Parse font data
     fontstash_t font_stash = init_fontstash();
-    font_t font = load_font(font_stash, font_data_buf, fontfile_sz);
+    font_t font = load_font(font_stash, 32.0f, fontfile.data, fontfile.size);
 
     // Render sample memory bitmap
     const char* text = "Crazy cows all over the place";
     unsigned char* tex_data;
     int width, height;
-    tex_data = malloc(get_min_buf_size(font, text));
-    draw_text_mem_buf(font, text, tex_data, &width, &height);
+    tex_data = malloc(get_min_buf_size(font_stash, font, text));
+    draw_text_mem_buf(font_stash, font, text, tex_data, &width, &height);
 
     // Write output
     stbi_write_png("out.png", width, height, 1, tex_data, width);
 
     // Release font resources
     free(tex_data);
-    free(font_data_buf);
     free_fontstash(font_stash);
+    close_asset(&fontfile);
  */
-void draw_text_mem_buf(font_t font, const char* text, unsigned char* buf, int* width, int* height);
+void draw_text_mem_buf(fontstash_t fs, font_t font, const char* text, unsigned char* buf, int* width, int* height);
+/*
+  Alpha blends UTF-8 text in the given colour into a CPU frame buffer, such as
+  a frame about to be exported. (x, y) is the top left corner of the first line,
+  newlines start a new line below and everything is clipped to the buffer
+ */
+void composite_text(fontstash_t fs, font_t font, const char* text, int x, int y, float r, float g, float b, const struct pixel_buffer* dst);
 
-/* Renders text to the given coordinates */
+/*
+  Renders UTF-8 text to the given coordinates, newlines start a new line below.
+  The first call creates the fontstash's text pipeline and the first use of a font
+  uploads its atlas. Layouts of recently drawn strings stay on the GPU, so redrawing
+  an unchanged string at any position and colour costs no layout work. Needs the
+  context the fontstash is used with current
+ */
 void draw_text(fontstash_t fs, font_t font, const char* string, float x, float y, float r, float g, float b);
+/*
+  Renders UTF-8 text scaled to the given pixel height. Distance field fonts stay
+  sharp at any height, bitmap fonts are stretched and blur away from their own
+ */
+void draw_text_scaled(fontstash_t fs, font_t font, const char* string, float x, float y, float pixel_height, float r, float g, float b);
+/*
+  Renders UTF-8 text scaled to the given pixel height, wrapping lines before words
+  that would extend past wrap_width pixels. Words wider than a line are broken.
+  The line breaks are cached along with the rest of the layout
+ */
+void draw_text_wrapped(fontstash_t fs, font_t font, const char* string, float x, float y, float pixel_height, float wrap_width, float r, float g, float b);
 
 #endif // ! _FONT_H_
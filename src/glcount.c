@@ -0,0 +1,73 @@
+#include "glcount.h"
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+/* Number of GL objects created since the last take_gl_object_count */
+static volatile long created_objects = 0;
+
+static void count_objects(GLsizei n)
+{
+#ifdef _MSC_VER
+    InterlockedExchangeAdd(&created_objects, (long) n);
+#else
+    __atomic_fetch_add(&created_objects, (long) n, __ATOMIC_RELAXED);
+#endif
+}
+
+GLuint create_gl_shader(GLenum type)
+{
+    count_objects(1);
+    return glCreateShader(type);
+}
+
+GLuint create_gl_program()
+{
+    count_objects(1);
+    return glCreateProgram();
+}
+
+void gen_gl_buffers(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenBuffers(n, ids);
+}
+
+void gen_gl_vertex_arrays(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenVertexArrays(n, ids);
+}
+
+void gen_gl_textures(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenTextures(n, ids);
+}
+
+void gen_gl_queries(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenQueries(n, ids);
+}
+
+void gen_gl_framebuffers(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenFramebuffers(n, ids);
+}
+
+void gen_gl_renderbuffers(GLsizei n, GLuint* ids)
+{
+    count_objects(n);
+    glGenRenderbuffers(n, ids);
+}
+
+unsigned int take_gl_object_count()
+{
+#ifdef _MSC_VER
+    return (unsigned int) InterlockedExchange(&created_objects, 0);
+#else
+    return (unsigned int) __atomic_exchange_n(&created_objects, 0, __ATOMIC_RELAXED);
+#endif
+}
@@ -0,0 +1,54 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _GLCOUNT_H_
+#define _GLCOUNT_H_
+
+#include <glad/glad.h>
+
+/*
+  Counted GL object creation. Every object the program creates goes through
+  these instead of the plain glGen and glCreate calls, so that the tally
+  covers all of them and a steady state frame reports zero. Safe to call
+  from the compile worker's context
+ */
+GLuint create_gl_shader(GLenum type);
+GLuint create_gl_program();
+void gen_gl_buffers(GLsizei n, GLuint* ids);
+void gen_gl_vertex_arrays(GLsizei n, GLuint* ids);
+void gen_gl_textures(GLsizei n, GLuint* ids);
+void gen_gl_queries(GLsizei n, GLuint* ids);
+void gen_gl_framebuffers(GLsizei n, GLuint* ids);
+void gen_gl_renderbuffers(GLsizei n, GLuint* ids);
+
+/* Retrieves the number of objects created since the last call and restarts the count */
+unsigned int take_gl_object_count();
+
+#endif // ! _GLCOUNT_H_
@@ -0,0 +1,100 @@
+#include "gputimer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "glcount.h"
+
+/* Number of queries in flight, covers the frames the driver may queue */
+#define QUERY_RING 8
+/* Number of measurements kept for the statistics */
+#define TIMER_HISTORY 128
+
+struct gpu_timer
+{
+    GLuint queries[QUERY_RING];
+    unsigned int head;       /* Next query to issue */
+    unsigned int pending;    /* Queries issued but not read back, the oldest at head - pending */
+    int active;              /* Non zero between begin and end of a measured range */
+
+    double samples_ms[TIMER_HISTORY];
+    unsigned int sample_head, num_samples;
+};
+
+gpu_timer_t init_gpu_timer()
+{
+    gpu_timer_t t = calloc(1, sizeof(struct gpu_timer));
+    gen_gl_queries(QUERY_RING, t->queries);
+    return t;
+}
+
+void free_gpu_timer(gpu_timer_t t)
+{
+    glDeleteQueries(QUERY_RING, t->queries);
+    free(t);
+}
+
+/* Reads back the results that are available, oldest first */
+static void collect_results(gpu_timer_t t)
+{
+    while (t->pending > 0)
+    {
+        GLuint q = t->queries[(t->head + QUERY_RING - t->pending) % QUERY_RING];
+        GLint available = 0;
+        glGetQueryObjectiv(q, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q, GL_QUERY_RESULT, &ns);
+        t->samples_ms[t->sample_head] = ns * 1e-6;
+        t->sample_head = (t->sample_head + 1) % TIMER_HISTORY;
+        if (t->num_samples < TIMER_HISTORY)
+            t->num_samples++;
+        t->pending--;
+    }
+}
+
+void begin_gpu_timer(gpu_timer_t t)
+{
+    collect_results(t);
+    if (t->pending == QUERY_RING)
+        return;
+    glBeginQuery(GL_TIME_ELAPSED, t->queries[t->head]);
+    t->active = 1;
+}
+
+void end_gpu_timer(gpu_timer_t t)
+{
+    if (!t->active)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    t->active = 0;
+    t->head = (t->head + 1) % QUERY_RING;
+    t->pending++;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+void get_gpu_timer_stats(gpu_timer_t t, struct gpu_timer_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->samples = t->num_samples;
+    if (t->num_samples == 0)
+        return;
+
+    /* Order statistics from a sorted copy */
+    double sorted[TIMER_HISTORY];
+    memcpy(sorted, t->samples_ms, t->num_samples * sizeof(double));
+    qsort(sorted, t->num_samples, sizeof(double), compare_doubles);
+    stats->min_ms = sorted[0];
+    stats->max_ms = sorted[t->num_samples - 1];
+    stats->p99_ms = sorted[(t->num_samples * 99 - 1) / 100];
+
+    for (unsigned int i = 0; i < t->num_samples; ++i)
+        stats->avg_ms += sorted[i];
+    stats->avg_ms /= t->num_samples;
+}
@@ -0,0 +1,67 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _GPUTIMER_H_
+#define _GPUTIMER_H_
+
+/* Opaque datatype that measures the GPU time of a command range */
+typedef struct gpu_timer* gpu_timer_t;
+
+/* Statistics over the recently completed measurements, in milliseconds */
+struct gpu_timer_stats
+{
+    unsigned int samples;  /* Number of measurements the statistics cover */
+    double avg_ms;
+    double min_ms;
+    double max_ms;
+    double p99_ms;
+};
+
+/*
+  Constructs a GPU timer. Measurements are read back a few frames
+  late from a ring of queries, so that the pipeline is never stalled
+ */
+gpu_timer_t init_gpu_timer();
+/* Deallocates a GPU timer's queries */
+void free_gpu_timer(gpu_timer_t t);
+
+/*
+  Starts measuring the commands issued until end_gpu_timer. Ranges of
+  different timers must not nest. If every query of the ring is still
+  in flight the range is not measured
+ */
+void begin_gpu_timer(gpu_timer_t t);
+/* Ends the range started by begin_gpu_timer */
+void end_gpu_timer(gpu_timer_t t);
+
+/* Computes the statistics of the completed measurements */
+void get_gpu_timer_stats(gpu_timer_t t, struct gpu_timer_stats* stats);
+
+#endif // ! _GPUTIMER_H_
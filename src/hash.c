@@ -0,0 +1,18 @@
+#include "hash.h"
+#include <string.h>
+
+unsigned long long hash_bytes(unsigned long long h, const void* data, size_t len)
+{
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+unsigned long long hash_string(unsigned long long h, const char* s)
+{
+    return hash_bytes(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
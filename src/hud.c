@@ -0,0 +1,16 @@
+#include "hud.h"
+#include <stdio.h>
+
+void draw_perf_hud(fontstash_t fs, font_t font, const struct hud_timer* timers, unsigned int num_timers,
+                   float x, float y, float line_height)
+{
+    char line[128];
+    for (unsigned int i = 0; i < num_timers; ++i)
+    {
+        struct gpu_timer_stats st;
+        get_gpu_timer_stats(timers[i].timer, &st);
+        snprintf(line, sizeof(line), "%-6s avg %6.3f min %6.3f max %6.3f p99 %6.3f ms",
+                 timers[i].label, st.avg_ms, st.min_ms, st.max_ms, st.p99_ms);
+        draw_text(fs, font, line, x, y - i * line_height, 1.0f, 1.0f, 0.0f);
+    }
+}
@@ -1,3 +1,4 @@
+#ifdef _WIN32
 #include "input.h"
 #include <string.h>
 #include <windows.h>
@@ -132,3 +133,4 @@ void populate_keycode_map(int* map, unsigned int size)
     map[0x037] = KEY_KP_MULTIPLY;
     map[0x04A] = KEY_KP_SUBTRACT;
 }
+#endif
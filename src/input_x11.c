@@ -0,0 +1,137 @@
+#if !defined(_WIN32)
+#include "input.h"
+
+void populate_keycode_map(int* map, unsigned int size)
+{
+    /* Set every mapping to invalid */
+    for (unsigned int i = 0; i < size; ++i)
+        map[i] = KEY_UNKNOWN;
+
+    /* Populate X11 keycode map, X keycodes are evdev scancodes offset by 8 */
+    map[0x013] = KEY_NUM0;
+    map[0x00A] = KEY_NUM1;
+    map[0x00B] = KEY_NUM2;
+    map[0x00C] = KEY_NUM3;
+    map[0x00D] = KEY_NUM4;
+    map[0x00E] = KEY_NUM5;
+    map[0x00F] = KEY_NUM6;
+    map[0x010] = KEY_NUM7;
+    map[0x011] = KEY_NUM8;
+    map[0x012] = KEY_NUM9;
+
+    map[0x026] = KEY_A;
+    map[0x038] = KEY_B;
+    map[0x036] = KEY_C;
+    map[0x028] = KEY_D;
+    map[0x01A] = KEY_E;
+    map[0x029] = KEY_F;
+    map[0x02A] = KEY_G;
+    map[0x02B] = KEY_H;
+    map[0x01F] = KEY_I;
+    map[0x02C] = KEY_J;
+    map[0x02D] = KEY_K;
+    map[0x02E] = KEY_L;
+    map[0x03A] = KEY_M;
+    map[0x039] = KEY_N;
+    map[0x020] = KEY_O;
+    map[0x021] = KEY_P;
+    map[0x018] = KEY_Q;
+    map[0x01B] = KEY_R;
+    map[0x027] = KEY_S;
+    map[0x01C] = KEY_T;
+    map[0x01E] = KEY_U;
+    map[0x037] = KEY_V;
+    map[0x019] = KEY_W;
+    map[0x035] = KEY_X;
+    map[0x01D] = KEY_Y;
+    map[0x034] = KEY_Z;
+
+    map[0x05A] = KEY_KP0;
+    map[0x057] = KEY_KP1;
+    map[0x058] = KEY_KP2;
+    map[0x059] = KEY_KP3;
+    map[0x053] = KEY_KP4;
+    map[0x054] = KEY_KP5;
+    map[0x055] = KEY_KP6;
+    map[0x04F] = KEY_KP7;
+    map[0x050] = KEY_KP8;
+    map[0x051] = KEY_KP9;
+
+    map[0x043] = KEY_F1;
+    map[0x044] = KEY_F2;
+    map[0x045] = KEY_F3;
+    map[0x046] = KEY_F4;
+    map[0x047] = KEY_F5;
+    map[0x048] = KEY_F6;
+    map[0x049] = KEY_F7;
+    map[0x04A] = KEY_F8;
+    map[0x04B] = KEY_F9;
+    map[0x04C] = KEY_F10;
+    map[0x05F] = KEY_F11;
+    map[0x060] = KEY_F12;
+    map[0x0BF] = KEY_F13;
+    map[0x0C0] = KEY_F14;
+    map[0x0C1] = KEY_F15;
+    map[0x0C2] = KEY_F16;
+    map[0x0C3] = KEY_F17;
+    map[0x0C4] = KEY_F18;
+    map[0x0C5] = KEY_F19;
+    map[0x0C6] = KEY_F20;
+    map[0x0C7] = KEY_F21;
+    map[0x0C8] = KEY_F22;
+    map[0x0C9] = KEY_F23;
+    map[0x0CA] = KEY_F24;
+
+    map[0x030] = KEY_APOSTROPHE;
+    map[0x033] = KEY_BACKSLASH;
+    map[0x03B] = KEY_COMMA;
+    map[0x015] = KEY_EQUAL;
+    map[0x031] = KEY_GRAVE_ACCENT;
+    map[0x022] = KEY_LEFT_BRACKET;
+    map[0x014] = KEY_MINUS;
+    map[0x03C] = KEY_PERIOD;
+    map[0x023] = KEY_RIGHT_BRACKET;
+    map[0x02F] = KEY_SEMICOLON;
+    map[0x03D] = KEY_SLASH;
+    map[0x05E] = KEY_WORLD1;
+
+    map[0x016] = KEY_BACKSPACE;
+    map[0x077] = KEY_DELETE;
+    map[0x073] = KEY_END;
+    map[0x024] = KEY_ENTER;
+    map[0x009] = KEY_ESCAPE;
+    map[0x06E] = KEY_HOME;
+    map[0x076] = KEY_INSERT;
+    map[0x087] = KEY_MENU;
+    map[0x075] = KEY_PAGE_DOWN;
+    map[0x070] = KEY_PAGE_UP;
+    map[0x07F] = KEY_PAUSE;
+    map[0x041] = KEY_SPACE;
+    map[0x017] = KEY_TAB;
+    map[0x042] = KEY_CAPS_LOCK;
+    map[0x04D] = KEY_NUM_LOCK;
+    map[0x04E] = KEY_SCROLL_LOCK;
+
+    map[0x040] = KEY_LEFT_ALT;
+    map[0x025] = KEY_LEFT_CONTROL;
+    map[0x032] = KEY_LEFT_SHIFT;
+    map[0x085] = KEY_LEFT_SUPER;
+    map[0x06B] = KEY_PRINT_SCREEN;
+    map[0x06C] = KEY_RIGHT_ALT;
+    map[0x069] = KEY_RIGHT_CONTROL;
+    map[0x03E] = KEY_RIGHT_SHIFT;
+    map[0x086] = KEY_RIGHT_SUPER;
+    map[0x074] = KEY_DOWN;
+    map[0x071] = KEY_LEFT;
+    map[0x072] = KEY_RIGHT;
+    map[0x06F] = KEY_UP;
+
+    map[0x056] = KEY_KP_ADD;
+    map[0x05B] = KEY_KP_DECIMAL;
+    map[0x06A] = KEY_KP_DIVIDE;
+    map[0x068] = KEY_KP_ENTER;
+    map[0x07D] = KEY_KP_EQUAL;
+    map[0x03F] = KEY_KP_MULTIPLY;
+    map[0x052] = KEY_KP_SUBTRACT;
+}
+#endif
@@ -1,60 +1,308 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include "window.h"
 #include "renderer.h"
 #include "timer.h"
 #include "font.h"
 #include "assetload.h"
+#include "assetmgr.h"
+#include "filewatch.h"
+#include "compiler.h"
+#include "progcache.h"
+#include "clock.h"
+#include "pacer.h"
+#include "gputimer.h"
+#include "hud.h"
+#include "glcount.h"
 
-#define FPS 25
+/* Quiet period after the last shader file event before reloading */
+#define RELOAD_SETTLE_MS 50
+
+/* Environment variable selecting fixed step time, in seconds per frame */
+#define FIXED_STEP_ENV "SHADERVIEW_FIXED_STEP"
+/* Shader time advanced by a single step of a paused realtime clock */
+#define CLOCK_STEP (1.0 / 60.0)
+/* Shader time moved by a single scrub */
+#define CLOCK_SCRUB 1.0
+
+/* Archive of packed assets, used for files missing on disk (see tools/packer) */
+#define ASSET_ARCHIVE "assets.svpk"
+
+/* Pixel height of the overlay font */
+#define FONT_HEIGHT 18
+
+/* Shader sources being loaded for the next build */
+struct shader_load
+{
+    asset_t vert, frag;
+    int pending;
+};
+
+/* Drops the sources of a load, if any */
+static void release_shader_files(asset_manager_t am, struct shader_load* sl)
+{
+    release_asset(am, sl->vert);
+    release_asset(am, sl->frag);
+    memset(sl, 0, sizeof(*sl));
+}
+
+/* Starts loading the given shader files, superseding a load in flight */
+static void request_shader_files(asset_manager_t am, struct shader_load* sl, const char* vert_path, const char* frag_path)
+{
+    release_shader_files(am, sl);
+    sl->vert = vert_path ? request_asset(am, vert_path, ASSET_TEXT) : 0;
+    sl->frag = frag_path ? request_asset(am, frag_path, ASSET_TEXT) : 0;
+    sl->pending = 1;
+}
+
+/*
+  Retrieves the sources of a load, null for paths not given. Returns zero while
+  a source is still loading, and reports and drops a load that failed
+ */
+static int get_shader_sources(asset_manager_t am, struct shader_load* sl, const char* vert_path, const char* frag_path,
+                              const char** vert_src, const char** frag_src)
+{
+    enum asset_state vert_state = vert_path ? get_asset_state(am, sl->vert) : ASSET_READY;
+    enum asset_state frag_state = frag_path ? get_asset_state(am, sl->frag) : ASSET_READY;
+    if (vert_state == ASSET_PENDING || frag_state == ASSET_PENDING)
+        return 0;
+
+    if (vert_state == ASSET_FAILED || frag_state == ASSET_FAILED)
+    {
+        fprintf(stderr, "Could not read shader sources\n");
+        release_shader_files(am, sl);
+        return 0;
+    }
+    const struct asset_data* vert = vert_path ? get_asset_data(am, sl->vert) : 0;
+    const struct asset_data* frag = frag_path ? get_asset_data(am, sl->frag) : 0;
+    *vert_src = vert ? (const char*) vert->bytes : 0;
+    *frag_src = frag ? (const char*) frag->bytes : 0;
+    return 1;
+}
+
+/* Queues a build once every source of the load arrived, null paths select the builtin shaders */
+static void submit_shader_files(asset_manager_t am, shader_compiler_t sc, struct shader_load* sl,
+                                const char* vert_path, const char* frag_path)
+{
+    const char *vert_src, *frag_src;
+    if (!sl->pending || !get_shader_sources(am, sl, vert_path, frag_path, &vert_src, &frag_src))
+        return;
+    submit_program(sc, vert_src, frag_src);
+    release_shader_files(am, sl);
+}
+
+/* Builds the program of a finished load on this thread and makes it current */
+static void load_shader_files(asset_manager_t am, struct render_context* rctx, struct shader_load* sl,
+                              const char* vert_path, const char* frag_path)
+{
+    const char *vert_src, *frag_src;
+    if (!sl->pending || !get_shader_sources(am, sl, vert_path, frag_path, &vert_src, &frag_src))
+        return;
+    load_shaders(rctx, vert_src, frag_src);
+    release_shader_files(am, sl);
+}
+
+/* Checks for a key that went down since the last check */
+static int key_hit(struct window* wnd, char* prev_keys, enum key k)
+{
+    int down = is_key_pressed(wnd, k);
+    int hit = down && !prev_keys[k];
+    prev_keys[k] = (char) down;
+    return hit;
+}
+
+/* Applies the keyboard time controls to the clock */
+static void handle_clock_keys(struct window* wnd, char* prev_keys, struct shader_clock* clk)
+{
+    if (key_hit(wnd, prev_keys, KEY_P))
+        pause_clock(clk, !clk->paused);
+    if (key_hit(wnd, prev_keys, KEY_PERIOD))
+        step_clock(clk, CLOCK_STEP);
+    if (key_hit(wnd, prev_keys, KEY_LEFT))
+        scrub_clock(clk, -CLOCK_SCRUB);
+    if (key_hit(wnd, prev_keys, KEY_RIGHT))
+        scrub_clock(clk, CLOCK_SCRUB);
+}
 
 int main(int argc, char* argv[])
 {
-    (void) argc;
-    (void) argv;
+    /* Usage: ShaderView [fragment shader [vertex shader]] */
+    const char* frag_path = argc > 1 ? argv[1] : 0;
+    const char* vert_path = argc > 2 ? argv[2] : 0;
 
     struct window window;
     struct render_context rctx;
 
     /* Init */
     open_window(&window);
-    init_renderer(&rctx);
+    if (window_should_close(&window))
+    {
+        close_window(&window);
+        return 1;
+    }
+    init_program_cache(0);
+    init_renderer(&rctx, window.width, window.height);
+
+    /* File reads and decoding happen off the frame loop, loose files override packed ones */
+    if (get_file_mtime(ASSET_ARCHIVE))
+        mount_archive(ASSET_ARCHIVE);
+    asset_manager_t assets = init_asset_manager();
+
+    /* Build and watch user shaders */
+    struct shader_load shader_load = {0, 0, 0};
+    time_val_t reload_change_at = get_timer_value(), reload_start_at = reload_change_at, reload_end_at = 0;
+    int reload_presented = 1;
+    shader_compiler_t compiler = 0;
+    filewatch_t shader_watch = 0;
+    if (frag_path || vert_path)
+    {
+        compiler = init_shader_compiler(&window);
+        request_shader_files(assets, &shader_load, vert_path, frag_path);
+        shader_watch = init_filewatch(RELOAD_SETTLE_MS);
+        if (frag_path)
+            watch_file(shader_watch, frag_path);
+        if (vert_path)
+            watch_file(shader_watch, vert_path);
+    }
 
-    /* Load font data */
-    const char* fontfile = "ext/Beeb.ttf";
-    long int fontfile_sz = get_filesize(fontfile);
-    unsigned char* font_data_buf = malloc(fontfile_sz);
-    read_file_to_mem(fontfile, font_data_buf, fontfile_sz);
+    /* Shader time, deterministic when a fixed step is given */
+    const char* fixed_step = getenv(FIXED_STEP_ENV);
+    struct shader_clock clock;
+    init_clock(&clock, fixed_step ? atof(fixed_step) : 0.0);
+    char prev_keys[KEY_LAST + 1] = {0};
 
-    /* Parse font data */
+    /* Font data, referenced by the font until it is freed */
+    asset_t font_asset = request_asset(assets, "ext/Beeb.ttf", ASSET_FONT);
     fontstash_t font_stash = init_fontstash();
-    font_t font = load_font(font_stash, 18, font_data_buf, fontfile_sz);
+    font_t font = 0;
+
+    /*
+      The first frame waits for startup assets and builds the initial program
+      synchronously, later requests load and build behind the frame loop
+     */
+    if (frag_path)
+        wait_asset(assets, shader_load.frag);
+    if (vert_path)
+        wait_asset(assets, shader_load.vert);
+    load_shader_files(assets, &rctx, &shader_load, vert_path, frag_path);
+    if (wait_asset(assets, font_asset) == ASSET_READY)
+    {
+        const struct asset_data* fontfile = get_asset_data(assets, font_asset);
+        font = load_font_stamped(font_stash, FONT_HEIGHT, fontfile->bytes, fontfile->size, fontfile->mtime);
+    }
+
+    /* Performance HUD, toggled with H */
+    gpu_timer_t text_timer = init_gpu_timer();
+    gpu_timer_t hud_timer = init_gpu_timer();
+    struct hud_timer hud_timers[] = { {"scene", rctx.gpu_timer}, {"text", text_timer}, {"hud", hud_timer} };
+    const unsigned int num_hud_timers = sizeof(hud_timers) / sizeof(hud_timers[0]);
+    int show_hud = 1;
+
+    /* GL objects created per frame, zero in the steady state, startup ones are not counted */
+    unsigned long gl_objects = 0, allocating_frames = 0;
+    take_gl_object_count();
 
     /* Main loop */
-    time_val_t t1 = get_timer_value();
+    frame_pacer_t pacer = init_frame_pacer(&window);
     while(!window_should_close(&window) && !is_key_pressed(&window, KEY_ESCAPE))
     {
-        time_val_t t2 = get_timer_value();
-        if (t2 - t1 >= 1000 / FPS)
+        begin_frame(pacer);
+        poll_window_events(&window);
+        if (window.width != rctx.width || window.height != rctx.height)
+            resize_renderer(&rctx, window.width, window.height);
+
+        /* Pick up finished loads */
+        poll_assets(assets);
+
+        /* Rebuild program on shader file changes, presenting the old one until it is ready */
+        if (shader_watch && poll_filewatch(shader_watch, &reload_change_at))
         {
-            poll_window_events(&window);
-            render(&rctx);
-            draw_text(
-                font_stash, font,
-                "Ninja cow", 0, 0,
-                0.0f, 0.0f, 1.0f
-            );
-            swap_buffers(&window);
+            reload_start_at = get_timer_value();
+            request_shader_files(assets, &shader_load, vert_path, frag_path);
         }
-        else
-            sleep((long)((1000 / FPS) - (t2 - t1)));
-        t1 = t2;
+        if (compiler)
+            submit_shader_files(assets, compiler, &shader_load, vert_path, frag_path);
+        GLuint program;
+        if (compiler && poll_program(compiler, &program) == BUILD_DONE)
+        {
+            set_program(&rctx, program);
+            reload_end_at = get_timer_value();
+            reload_presented = 0;
+        }
+
+        handle_clock_keys(&window, prev_keys, &clock);
+        if (key_hit(&window, prev_keys, KEY_H))
+            show_hud = !show_hud;
+        tick_clock(&clock);
+        render(&rctx, &clock);
+        gl_objects += rctx.stats.gl_objects_created;
+        allocating_frames += rctx.stats.gl_objects_created != 0;
+
+        begin_gpu_timer(text_timer);
+        draw_text(
+            font_stash, font,
+            "Ninja cow", 0, 0,
+            0.0f, 0.0f, 1.0f
+        );
+        end_gpu_timer(text_timer);
+
+        /* The HUD is timed on its own, so that showing it does not change the text figures */
+        if (show_hud)
+        {
+            begin_gpu_timer(hud_timer);
+            draw_perf_hud(font_stash, font, hud_timers, num_hud_timers,
+                          4.0f, (float)(rctx.height - FONT_HEIGHT), (float)FONT_HEIGHT);
+            end_gpu_timer(hud_timer);
+        }
+        end_frame(pacer);
+
+        /* Report change to photon latency of the first frame using a reloaded program */
+        if (!reload_presented)
+        {
+            glFinish();
+            double to_ms = 1000.0 / get_timer_precision();
+            printf("Shaders reloaded: build %.2f ms%s, change-to-photon %.2f ms\n",
+                   (reload_end_at - reload_start_at) * to_ms,
+                   get_compile_mode(compiler) == COMPILE_PARALLEL ? " (until the frame that saw it complete)" : "",
+                   (get_timer_value() - reload_change_at) * to_ms);
+            reload_presented = 1;
+        }
+    }
+
+    /* Report frame timings */
+    printf("GL objects: %lu created in the frame loop, by %lu frames\n", gl_objects, allocating_frames);
+    struct pacing_stats ps;
+    get_pacing_stats(pacer, &ps);
+    printf("Frame pacing (%s, last %u frames): cpu avg %.3f max %.3f ms, "
+           "interval avg %.3f min %.3f max %.3f jitter %.3f ms\n",
+           pacing_mode_name(get_pacing_mode(pacer)), ps.frames, ps.cpu_avg_ms, ps.cpu_max_ms,
+           ps.interval_avg_ms, ps.interval_min_ms, ps.interval_max_ms, ps.interval_jitter_ms);
+    free_frame_pacer(pacer);
+    for (unsigned int i = 0; i < num_hud_timers; ++i)
+    {
+        struct gpu_timer_stats gs;
+        get_gpu_timer_stats(hud_timers[i].timer, &gs);
+        printf("GPU %s (last %u frames): avg %.3f min %.3f max %.3f p99 %.3f ms\n",
+               hud_timers[i].label, gs.samples, gs.avg_ms, gs.min_ms, gs.max_ms, gs.p99_ms);
     }
+    free_gpu_timer(text_timer);
+    free_gpu_timer(hud_timer);
 
     /* Release font resources */
-    free(font_data_buf);
     free_fontstash(font_stash);
+    release_asset(assets, font_asset);
 
     /* Shutdown */
+    if (shader_watch)
+        free_filewatch(shader_watch);
+    if (compiler)
+        free_shader_compiler(compiler);
+    release_shader_files(assets, &shader_load);
+    free_asset_manager(assets);
+    unmount_archives();
     destroy_renderer(&rctx);
+    shutdown_program_cache();
     close_window(&window);
 
     return 0;
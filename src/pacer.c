@@ -0,0 +1,277 @@
+#include "pacer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+#include "timer.h"
+
+/* Environment variable selecting the pacing mode and rate */
+#define PACING_ENV "SHADERVIEW_PACING"
+/* Rate used when none is given */
+#define DEFAULT_RATE_HZ 60.0
+/* Number of frames kept for the statistics */
+#define PACING_HISTORY 256
+/*
+  Waits shorter than this are spun out instead of slept, covering the
+  wakeup latency of the scheduler so that deadlines are hit precisely
+ */
+#define SPIN_NS 2000000LL
+/* Adaptive mode, consecutive late frames before vsync is dropped */
+#define ADAPT_LATE_FRAMES 4
+/* Adaptive mode, consecutive fast frames before vsync is restored */
+#define ADAPT_FAST_FRAMES 30
+
+struct frame_pacer
+{
+    struct window* wnd;
+    enum pacing_mode mode;
+    time_val_t period;         /* Target frame period in nanoseconds */
+    time_val_t deadline;       /* Start time of the next frame when the CPU holds the rate */
+    time_val_t frame_start;    /* Start time of the current frame */
+    time_val_t last_present;   /* Time the previous swap returned, negative before the first one */
+
+    /* Adaptive mode without driver support for late swaps */
+    int soft_adaptive;
+    int vsync_on;
+    unsigned int late_run, fast_run;
+
+    /* Timing history rings */
+    double cpu_ms[PACING_HISTORY];
+    double interval_ms[PACING_HISTORY];
+    unsigned int cpu_head, cpu_count;
+    unsigned int interval_head, interval_count;
+};
+
+/* =------------------------------------------------------------------------= */
+static const char* mode_names[] = { "vsync", "uncapped", "fixed", "adaptive" };
+
+const char* pacing_mode_name(enum pacing_mode mode)
+{
+    return mode_names[mode];
+}
+
+/* Parses <mode>[:<hz>], returns zero on malformed input */
+static int parse_pacing(const char* s, enum pacing_mode* mode, double* rate)
+{
+    for (unsigned int i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); ++i)
+    {
+        size_t len = strlen(mode_names[i]);
+        if (strncmp(s, mode_names[i], len) != 0)
+            continue;
+        if (s[len] == ':')
+        {
+            double hz = atof(s + len + 1);
+            if (hz <= 0.0)
+                return 0;
+            *rate = hz;
+        }
+        else if (s[len] != '\0')
+            return 0;
+        *mode = (enum pacing_mode) i;
+        return 1;
+    }
+    return 0;
+}
+
+/* Sleeps most of the way to the given time and spins the rest */
+static void wait_until(time_val_t t)
+{
+    for (;;)
+    {
+        time_val_t remaining = t - get_time_ns();
+        if (remaining <= 0)
+            break;
+        if (remaining > SPIN_NS)
+            sleep_ms((long)((remaining - SPIN_NS) / 1000000LL));
+    }
+}
+
+frame_pacer_t init_frame_pacer(struct window* wnd)
+{
+    frame_pacer_t fp = calloc(1, sizeof(struct frame_pacer));
+    fp->wnd = wnd;
+    fp->last_present = -1;
+
+    /* Honour forced mode */
+    enum pacing_mode mode = PACING_VSYNC;
+    double rate = DEFAULT_RATE_HZ;
+    const char* forced = getenv(PACING_ENV);
+    int is_forced = forced && *forced;
+    if (is_forced && !parse_pacing(forced, &mode, &rate))
+    {
+        fprintf(stderr, "Ignoring malformed %s=%s\n", PACING_ENV, forced);
+        is_forced = 0;
+    }
+    fp->period = (time_val_t)(1e9 / rate);
+
+    /*
+      Configure the swap. Without swap control a requested vsync is held
+      on the CPU, while the default runs uncapped as there is no display
+      to sync to, e.g. offscreen
+     */
+    switch (mode)
+    {
+        case PACING_VSYNC:
+            if (!set_swap_interval(wnd, 1))
+            {
+                mode = is_forced ? PACING_FIXED : PACING_UNCAPPED;
+                if (is_forced)
+                    fprintf(stderr, "No swap control, pacing at %.2f Hz instead of vsync\n", rate);
+                set_swap_interval(wnd, 0);
+            }
+            break;
+        case PACING_ADAPTIVE:
+            if (!set_swap_interval(wnd, -1))
+            {
+                /* Emulate late swaps by toggling vsync on observed frame times */
+                fp->soft_adaptive = 1;
+                fp->vsync_on = set_swap_interval(wnd, 1);
+            }
+            break;
+        case PACING_UNCAPPED:
+        case PACING_FIXED:
+            set_swap_interval(wnd, 0);
+            break;
+    }
+    fp->mode = mode;
+
+#ifdef _WIN32
+    /* Default scheduler granularity is too coarse for the sleep part of waits */
+    timeBeginPeriod(1);
+#endif
+    return fp;
+}
+
+void free_frame_pacer(frame_pacer_t fp)
+{
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+    free(fp);
+}
+
+enum pacing_mode get_pacing_mode(frame_pacer_t fp)
+{
+    return fp->mode;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Whether the CPU holds the frame rate this frame */
+static int cpu_paced(frame_pacer_t fp)
+{
+    return fp->mode == PACING_FIXED || (fp->soft_adaptive && !fp->vsync_on);
+}
+
+void begin_frame(frame_pacer_t fp)
+{
+    time_val_t now = get_time_ns();
+    if (cpu_paced(fp))
+    {
+        if (fp->deadline == 0)
+            fp->deadline = now;
+        wait_until(fp->deadline);
+        now = get_time_ns();
+
+        /*
+         Deadlines advance by whole periods so that rounding never accumulates,
+         unless a frame ran a full period late, which would otherwise be
+         followed by a burst of unpaced catch up frames
+         */
+        fp->deadline += fp->period;
+        if (now > fp->deadline)
+            fp->deadline = now + fp->period;
+    }
+    else
+        fp->deadline = 0;
+    fp->frame_start = now;
+}
+
+/* Toggles vsync on the recent frame times in emulated adaptive mode */
+static void adapt_vsync(frame_pacer_t fp, time_val_t busy, time_val_t interval)
+{
+    if (fp->vsync_on)
+    {
+        /* Missing vblanks halves the rate, tearing is preferable */
+        fp->late_run = interval > fp->period + fp->period / 4 ? fp->late_run + 1 : 0;
+        if (fp->late_run >= ADAPT_LATE_FRAMES && set_swap_interval(fp->wnd, 0))
+        {
+            fp->vsync_on = 0;
+            fp->late_run = 0;
+        }
+    }
+    else
+    {
+        /* Resync once frames fit comfortably again */
+        fp->fast_run = busy < (fp->period * 3) / 4 ? fp->fast_run + 1 : 0;
+        if (fp->fast_run >= ADAPT_FAST_FRAMES && set_swap_interval(fp->wnd, 1))
+        {
+            fp->vsync_on = 1;
+            fp->fast_run = 0;
+        }
+    }
+}
+
+void end_frame(frame_pacer_t fp)
+{
+    time_val_t submit = get_time_ns();
+    swap_buffers(fp->wnd);
+    time_val_t now = get_time_ns();
+
+    fp->cpu_ms[fp->cpu_head] = (submit - fp->frame_start) * 1e-6;
+    fp->cpu_head = (fp->cpu_head + 1) % PACING_HISTORY;
+    if (fp->cpu_count < PACING_HISTORY)
+        fp->cpu_count++;
+
+    if (fp->last_present >= 0)
+    {
+        time_val_t interval = now - fp->last_present;
+        fp->interval_ms[fp->interval_head] = interval * 1e-6;
+        fp->interval_head = (fp->interval_head + 1) % PACING_HISTORY;
+        if (fp->interval_count < PACING_HISTORY)
+            fp->interval_count++;
+        if (fp->soft_adaptive)
+            adapt_vsync(fp, now - fp->frame_start, interval);
+    }
+    fp->last_present = now;
+}
+
+void get_pacing_stats(frame_pacer_t fp, struct pacing_stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frames = fp->cpu_count;
+
+    for (unsigned int i = 0; i < fp->cpu_count; ++i)
+    {
+        stats->cpu_avg_ms += fp->cpu_ms[i];
+        if (fp->cpu_ms[i] > stats->cpu_max_ms)
+            stats->cpu_max_ms = fp->cpu_ms[i];
+    }
+    if (fp->cpu_count)
+        stats->cpu_avg_ms /= fp->cpu_count;
+
+    if (fp->interval_count == 0)
+        return;
+    stats->interval_min_ms = fp->interval_ms[0];
+    for (unsigned int i = 0; i < fp->interval_count; ++i)
+    {
+        double v = fp->interval_ms[i];
+        stats->interval_avg_ms += v;
+        if (v < stats->interval_min_ms)
+            stats->interval_min_ms = v;
+        if (v > stats->interval_max_ms)
+            stats->interval_max_ms = v;
+    }
+    stats->interval_avg_ms /= fp->interval_count;
+
+    double var = 0.0;
+    for (unsigned int i = 0; i < fp->interval_count; ++i)
+    {
+        double d = fp->interval_ms[i] - stats->interval_avg_ms;
+        var += d * d;
+    }
+    stats->interval_jitter_ms = sqrt(var / fp->interval_count);
+}
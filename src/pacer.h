@@ -0,0 +1,82 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#include "window.h"
+
+/* Opaque datatype that paces the frame loop */
+typedef struct frame_pacer* frame_pacer_t;
+
+/* Frame pacing strategies */
+enum pacing_mode
+{
+    PACING_VSYNC = 0, /* Swaps wait for the vertical blank */
+    PACING_UNCAPPED,  /* No waits at all, for benchmarking */
+    PACING_FIXED,     /* Target rate held by the CPU with vsync off */
+    PACING_ADAPTIVE   /* Vsync while frames keep up, late frames are swapped immediately */
+};
+
+/* Frame timings over the recent frame history */
+struct pacing_stats
+{
+    unsigned int frames;        /* Number of frames the statistics cover */
+    double cpu_avg_ms;          /* CPU time from frame start until the swap was issued */
+    double cpu_max_ms;
+    double interval_avg_ms;     /* Time between consecutive swaps returning */
+    double interval_min_ms;
+    double interval_max_ms;
+    double interval_jitter_ms;  /* Standard deviation of the interval */
+};
+
+/*
+  Constructs a pacer for the given window. Defaults to vsync, or uncapped
+  when the platform has no swap control, where a forced vsync falls back
+  to a fixed rate. SHADERVIEW_PACING=vsync|uncapped|fixed|adaptive[:<hz>]
+  overrides it, the rate defaults to 60 Hz
+ */
+frame_pacer_t init_frame_pacer(struct window* wnd);
+/* Deallocates a pacer */
+void free_frame_pacer(frame_pacer_t fp);
+/* Retrieves the pacing mode in use */
+enum pacing_mode get_pacing_mode(frame_pacer_t fp);
+/* Retrieves the name of a pacing mode */
+const char* pacing_mode_name(enum pacing_mode mode);
+
+/* Waits until the next frame is due, marking the start of its CPU work */
+void begin_frame(frame_pacer_t fp);
+/* Swaps the window's buffers and records the frame's timings */
+void end_frame(frame_pacer_t fp);
+
+/* Computes the statistics of the recent frames */
+void get_pacing_stats(frame_pacer_t fp, struct pacing_stats* stats);
+
+#endif // ! _PACER_H_
@@ -0,0 +1,259 @@
+#include "progcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "window.h"
+#include "thread.h"
+#include "timer.h"
+#include "assetload.h"
+#include "glcount.h"
+#include "hash.h"
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+/* Cache file identification */
+#define CACHE_MAGIC   0x43505653u /* "SVPC" */
+#define CACHE_VERSION 1u
+
+/* Header preceding the program binary in every cache file */
+struct cache_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int format;          /* Binary format as returned by glGetProgramBinary */
+    unsigned int length;          /* Binary length in bytes */
+    unsigned long long key;       /* Key the entry was stored under, guards against collisions in file names */
+    double build_ms;              /* Time the compile and link took when the entry was stored */
+};
+
+/* ARB_get_program_binary entry points, core since 4.1 and not loaded by glad */
+typedef void (APIENTRYP get_program_binary_fn)(GLuint program, GLsizei buf_size, GLsizei* length, GLenum* format, void* binary);
+typedef void (APIENTRYP program_binary_fn)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (APIENTRYP program_parameteri_fn)(GLuint program, GLenum pname, GLint value);
+
+/* Process wide cache state */
+static struct
+{
+    int enabled;
+    char* dir;
+    unsigned long long driver_hash;  /* Hash of the vendor, renderer and version strings */
+    get_program_binary_fn get_program_binary;
+    program_binary_fn program_binary;
+    program_parameteri_fn program_parameteri;
+
+    /* Statistics, updated from the compile worker too */
+    mutex_t lock;
+    unsigned int hits, misses, rejected;
+    double saved_ms;
+} cache;
+
+/* =------------------------------------------------------------------------= */
+/* Builds the path of the cache file for the given key */
+static void entry_path(char* buf, size_t sz, unsigned long long key)
+{
+    snprintf(buf, sz, "%s/%016llx.bin", cache.dir, key);
+}
+
+static double elapsed_ms(time_val_t since)
+{
+    return (double)(get_timer_value() - since) * 1000.0 / get_timer_precision();
+}
+
+/* =------------------------------------------------------------------------= */
+int init_program_cache(const char* dir)
+{
+    memset(&cache, 0, sizeof(cache));
+
+    /* Drivers may support the entry points but expose no formats */
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    cache.get_program_binary = (get_program_binary_fn) get_gl_proc_address("glGetProgramBinary");
+    cache.program_binary = (program_binary_fn) get_gl_proc_address("glProgramBinary");
+    cache.program_parameteri = (program_parameteri_fn) get_gl_proc_address("glProgramParameteri");
+    if (num_formats <= 0 || !cache.get_program_binary || !cache.program_binary || !cache.program_parameteri)
+    {
+        fprintf(stderr, "Program cache disabled: no program binary support\n");
+        return 0;
+    }
+
+    /* Resolve the directory */
+    dir = get_cache_dir(dir);
+    cache.dir = malloc(strlen(dir) + 1);
+    strcpy(cache.dir, dir);
+    make_dir(cache.dir);
+
+    /* Binaries are only valid for the exact driver that produced them */
+    unsigned long long h = HASH_SEED;
+    h = hash_string(h, (const char*) glGetString(GL_VENDOR));
+    h = hash_string(h, (const char*) glGetString(GL_RENDERER));
+    h = hash_string(h, (const char*) glGetString(GL_VERSION));
+    cache.driver_hash = h;
+
+    cache.lock = mutex_create();
+    cache.enabled = 1;
+    return 1;
+}
+
+void shutdown_program_cache()
+{
+    if (!cache.enabled)
+        return;
+    printf("Program cache: %u hits, %u misses, %u rejected, saved %.2f ms\n",
+           cache.hits, cache.misses, cache.rejected, cache.saved_ms);
+    mutex_destroy(cache.lock);
+    free(cache.dir);
+    cache.enabled = 0;
+}
+
+int program_cache_enabled()
+{
+    return cache.enabled;
+}
+
+unsigned long long program_cache_key(const char* vert_src, const char* frag_src)
+{
+    unsigned long long h = cache.driver_hash;
+    h = hash_string(h, vert_src);
+    h = hash_string(h, frag_src);
+    return h;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Reads the cache file of the given key, returning its binary or null */
+static void* read_entry(unsigned long long key, struct cache_header* hdr)
+{
+    char path[1024];
+    entry_path(path, sizeof(path), key);
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return 0;
+
+    void* blob = 0;
+    if (fread(hdr, sizeof(*hdr), 1, f) == 1
+     && hdr->magic == CACHE_MAGIC
+     && hdr->version == CACHE_VERSION
+     && hdr->key == key
+     && hdr->length > 0)
+    {
+        blob = malloc(hdr->length);
+        if (fread(blob, 1, hdr->length, f) != hdr->length)
+        {
+            free(blob);
+            blob = 0;
+        }
+    }
+    fclose(f);
+    return blob;
+}
+
+GLuint load_cached_program(unsigned long long key)
+{
+    if (!cache.enabled)
+        return 0;
+
+    time_val_t start = get_timer_value();
+    struct cache_header hdr;
+    void* blob = read_entry(key, &hdr);
+    GLuint program = 0;
+    int rejected = 0;
+    if (blob)
+    {
+        /* Driver updates not reflected in the version string still reject old binaries here */
+        program = create_gl_program();
+        cache.program_binary(program, hdr.format, blob, (GLsizei) hdr.length);
+        free(blob);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE)
+        {
+            glDeleteProgram(program);
+            program = 0;
+            rejected = 1;
+        }
+    }
+
+    mutex_lock(cache.lock);
+    if (program)
+    {
+        cache.hits++;
+        double saved = hdr.build_ms - elapsed_ms(start);
+        if (saved > 0.0)
+            cache.saved_ms += saved;
+    }
+    else
+    {
+        cache.misses++;
+        cache.rejected += rejected;
+    }
+    mutex_unlock(cache.lock);
+    return program;
+}
+
+void prepare_cached_program(GLuint program)
+{
+    if (cache.enabled)
+        cache.program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void store_cached_program(unsigned long long key, GLuint program, double build_ms)
+{
+    if (!cache.enabled)
+        return;
+
+    /* Fetch the binary */
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    void* blob = malloc(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    cache.get_program_binary(program, length, &written, &format, blob);
+    if (written <= 0)
+    {
+        free(blob);
+        return;
+    }
+
+    struct cache_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = CACHE_MAGIC;
+    hdr.version = CACHE_VERSION;
+    hdr.format = format;
+    hdr.length = (unsigned int) written;
+    hdr.key = key;
+    hdr.build_ms = build_ms;
+
+    /* Write to a temporary and rename it in place, so that readers never see partial entries */
+    char path[1024], tmp_path[1040];
+    entry_path(path, sizeof(path), key);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Could not write program cache entry %s\n", tmp_path);
+        free(blob);
+        return;
+    }
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+          && fwrite(blob, 1, hdr.length, f) == hdr.length;
+    ok = fclose(f) == 0 && ok;
+    free(blob);
+#ifdef _WIN32
+    /* rename does not replace existing files on windows */
+    remove(path);
+#endif
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Could not write program cache entry %s\n", path);
+        remove(tmp_path);
+    }
+}
@@ -0,0 +1,71 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _PROGCACHE_H_
+#define _PROGCACHE_H_
+
+#include <glad/glad.h>
+
+/*
+  On disk cache of linked program binaries. Entries are keyed by a hash of
+  the shader sources and the GL vendor, renderer and version strings, so a
+  driver update or a different GPU never sees foreign binaries.
+  The cache is process wide and may be used from any thread with a current
+  context sharing objects with the one it was initialized on
+ */
+
+/*
+  Initializes the cache in the given directory for the current context.
+  Returns zero and leaves the cache disabled if the driver cannot
+  retrieve program binaries
+ */
+int init_program_cache(const char* dir);
+/* Logs the cache statistics and disables the cache */
+void shutdown_program_cache();
+/* Checks whether the cache is in use */
+int program_cache_enabled();
+
+/* Computes the cache key of the given sources */
+unsigned long long program_cache_key(const char* vert_src, const char* frag_src);
+/*
+  Creates a program from the cached binary with the given key.
+  Returns zero on a miss or if the driver rejects the binary
+ */
+GLuint load_cached_program(unsigned long long key);
+/*
+  Stores the binary of the given linked program. The program must have been
+  linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, see prepare_cached_program.
+  The build time is recorded to report the time saved by later hits
+ */
+void store_cached_program(unsigned long long key, GLuint program, double build_ms);
+/* Marks a program that is about to be linked as retrievable */
+void prepare_cached_program(GLuint program);
+
+#endif // ! _PROGCACHE_H_
@@ -2,16 +2,22 @@
 #include <GL/glu.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "timer.h"
-#include "defshdr.h"
+#include <string.h>
+#include "compiler.h"
+#include "glcount.h"
 
 /* --------------------------------------------------
- * Renders a screen space quad
+ * Uploads the fullscreen geometry used by the preview pass
  * -------------------------------------------------- */
-static void render_quad()
+static void init_fullscreen_geometry(struct render_context* ctx)
 {
-    GLfloat quad_vert[] =
+    GLfloat fs_vert[] =
     {
+        /* Oversized triangle, clipped to the viewport */
+       -1.0f, -1.0f, 0.0f,
+        3.0f, -1.0f, 0.0f,
+       -1.0f,  3.0f, 0.0f,
+        /* Quad as triangle strip */
        -1.0f,  1.0f, 0.0f,
        -1.0f, -1.0f, 0.0f,
         1.0f,  1.0f, 0.0f,
@@ -19,26 +25,31 @@ static void render_quad()
     };
 
     /* Setup vertex data */
-    GLuint quad_vbo;
-    glGenBuffers(1, &quad_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vert), &quad_vert, GL_STATIC_DRAW);
+    gen_gl_buffers(1, &ctx->fs_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->fs_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(fs_vert), fs_vert, GL_STATIC_DRAW);
 
     /* Setup vertex attributes */
-    GLuint quad_vao;
-    glGenVertexArrays(1, &quad_vao);
-    glBindVertexArray(quad_vao);
+    gen_gl_vertex_arrays(1, &ctx->fs_vao);
+    glBindVertexArray(ctx->fs_vao);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
     glEnableVertexAttribArray(0);
 
-    /* Dispatch draw operation */
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    /* Free uploaded resources */
+    glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* --------------------------------------------------
+ * Renders a screen space covering primitive
+ * -------------------------------------------------- */
+static void render_fullscreen(struct render_context* ctx)
+{
+    glBindVertexArray(ctx->fs_vao);
+    if (ctx->fs_prim == FULLSCREEN_TRIANGLE)
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    else
+        glDrawArrays(GL_TRIANGLE_STRIP, 3, 4);
     glBindVertexArray(0);
-    glDeleteBuffers(1, &quad_vbo);
-    glDeleteVertexArrays(1, &quad_vao);
 }
 
 /* --------------------------------------------------
@@ -54,101 +65,137 @@ static void check_error()
     }
 }
 
+/* Name, type and id of the builtin uniforms */
+static const struct
+{
+    const char* name;
+    GLenum type;
+    enum builtin_uniform builtin;
+} builtin_uniforms[] =
+{
+    {"time",       GL_FLOAT,      UNIFORM_TIME},
+    {"time_delta", GL_FLOAT,      UNIFORM_TIME_DELTA},
+    {"frame",      GL_INT,        UNIFORM_FRAME},
+    {"resolution", GL_FLOAT_VEC2, UNIFORM_RESOLUTION}
+};
+
 /* --------------------------------------------------
- * Checks and shows last shader compile error occurred
+ * Fills the uniform table with the program's active uniforms
  * -------------------------------------------------- */
-static void check_last_compile_error(GLuint id)
+static void reflect_uniforms(struct render_context* ctx)
 {
-    /* Check if last compile was successful */
-    GLint compileStatus;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &compileStatus);
-    if (compileStatus == GL_FALSE)
+    ctx->num_uniforms = 0;
+
+    GLint num_active = 0;
+    glGetProgramiv(ctx->program, GL_ACTIVE_UNIFORMS, &num_active);
+
+    for (GLint i = 0; i < num_active; ++i)
     {
-        /* Gather the compile log size */
-        GLint logLength;
-        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength != 0)
+        /* Query uniform properties */
+        GLchar name[64];
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(ctx->program, (GLuint)i, sizeof(name), 0, &size, &type, name);
+        GLint location = glGetUniformLocation(ctx->program, name);
+
+        /* Skip uniform block members */
+        if (location < 0)
+            continue;
+
+        if (ctx->num_uniforms == MAX_UNIFORMS)
+        {
+            fprintf(stderr, "Uniform table full, ignoring: %s\n", name);
+            continue;
+        }
+
+        /* Match against the builtins */
+        enum builtin_uniform builtin = UNIFORM_USER;
+        for (size_t j = 0; j < sizeof(builtin_uniforms) / sizeof(builtin_uniforms[0]); ++j)
         {
-            /* Fetch and print log */
-            GLchar* buf = malloc(logLength * sizeof(GLchar));
-            glGetShaderInfoLog(id, logLength, 0, buf);
-            fprintf(stderr, "Shader error: %s", buf);
-            free(buf);
+            if (strcmp(name, builtin_uniforms[j].name) == 0)
+            {
+                if (type == builtin_uniforms[j].type)
+                    builtin = builtin_uniforms[j].builtin;
+                else
+                    fprintf(stderr, "Builtin uniform %s declared with wrong type\n", name);
+                break;
+            }
         }
+
+        struct uniform_info* ui = ctx->uniforms + ctx->num_uniforms++;
+        ui->location = location;
+        ui->type = type;
+        ui->builtin = builtin;
     }
 }
 
 /* --------------------------------------------------
- * Checks and shows last shader link error occurred
+ * Replaces the current program with the given linked one
  * -------------------------------------------------- */
-static void check_last_link_error(GLuint id)
+void set_program(struct render_context* ctx, GLuint program)
 {
-    /* Check if last link was successful */
-    GLint status;
-    glGetProgramiv(id, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE)
-    {
-        /* Gather the link log size */
-        GLint logLength;
-        glGetProgramiv(id, GL_INFO_LOG_LENGTH, &logLength);
-        if (logLength != 0)
-        {
-            /* Fetch and print log */
-            GLchar* buf = malloc(logLength * sizeof(GLchar));
-            glGetProgramInfoLog(id, logLength, 0, buf);
-            fprintf(stderr, "Shader program error: %s", buf);
-            free(buf);
-        }
-    }
+    glDeleteProgram(ctx->program);
+    ctx->program = program;
+
+    /* Gather uniform locations */
+    reflect_uniforms(ctx);
+}
+
+/* --------------------------------------------------
+ * Builds a program from the given sources and makes it current
+ * -------------------------------------------------- */
+int load_shaders(struct render_context* ctx, const char* vert_src, const char* frag_src)
+{
+    /* Keep the last good program on failure */
+    GLuint program = build_program(vert_src, frag_src);
+    if (!program)
+        return 0;
+    set_program(ctx, program);
+    return 1;
 }
 
 /* --------------------------------------------------
- * Uploads given texture data to the GPU
+ * Initializes renderer state
  * -------------------------------------------------- */
-static GLuint load_texture(int width, int height, GLvoid* data)
+void init_renderer(struct render_context* ctx, int width, int height)
 {
-    GLuint id;
-    glGenTextures(1, &id);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    resize_renderer(ctx, width, height);
 
-    glBindTexture(GL_TEXTURE_2D, id);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    /* Build the default program */
+    ctx->program = 0;
+    ctx->num_uniforms = 0;
+    load_shaders(ctx, 0, 0);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    /* Create persistent fullscreen geometry */
+    init_fullscreen_geometry(ctx);
+    ctx->fs_prim = FULLSCREEN_TRIANGLE;
+
+    /* Measures the preview pass */
+    ctx->gpu_timer = init_gpu_timer();
     check_error();
-    return id;
+
+    /* Statistics count from here, setup objects are not per frame churn */
+    take_gl_object_count();
+    ctx->stats.gl_objects_created = 0;
 }
 
 /* --------------------------------------------------
- * Initializes renderer state
+ * Resizes the viewport
  * -------------------------------------------------- */
-void init_renderer(struct render_context* ctx)
+void resize_renderer(struct render_context* ctx, int width, int height)
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glViewport(0, 0, 800, 600);
-
-    /* Compile vertex shader */
-    GLuint vert_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vert_shader, 1, &def_vert_sh_src, 0);
-    glCompileShader(vert_shader);
-    check_last_compile_error(vert_shader);
-    ctx->vert_shader = vert_shader;
-
-    /* Compile fragment shader */
-    GLuint frag_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(frag_shader, 1, &def_frag_sh_src, 0);
-    glCompileShader(frag_shader);
-    check_last_compile_error(frag_shader);
-    ctx->frag_shader = frag_shader;
-
-    /* Link shader program */
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vert_shader);
-    glAttachShader(shader_program, frag_shader);
-    glLinkProgram(shader_program);
-    check_last_link_error(shader_program);
-    ctx->program = shader_program;
+    glViewport(0, 0, width, height);
+    ctx->width = width;
+    ctx->height = height;
+}
+
+/* --------------------------------------------------
+ * Selects the primitive used to cover the screen
+ * -------------------------------------------------- */
+void set_fullscreen_prim(struct render_context* ctx, enum fullscreen_prim prim)
+{
+    ctx->fs_prim = prim;
 }
 
 struct pixel
@@ -162,21 +209,42 @@ struct pixel
 /* --------------------------------------------------
  * Main render function
  * -------------------------------------------------- */
-void render(struct render_context* ctx)
+void render(struct render_context* ctx, const struct shader_clock* clk)
 {
+    /* Close previous frame's statistics */
+    ctx->stats.gl_objects_created = take_gl_object_count();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     /* Setup uniforms */
     glUseProgram(ctx->program);
-    glBindAttribLocation(ctx->program, 0, "position");
 
-    long long timer_value = get_timer_value();
-    float time = ((timer_value / 30000) % 200) / 100.0f;
-    glUniform1f(glGetUniformLocation(ctx->program, "time"), time);
-    glUniform2f(glGetUniformLocation(ctx->program, "resolution"), 800.0f, 600.0f);
+    for (unsigned int i = 0; i < ctx->num_uniforms; ++i)
+    {
+        const struct uniform_info* ui = ctx->uniforms + i;
+        switch (ui->builtin)
+        {
+            case UNIFORM_TIME:
+                glUniform1f(ui->location, (float)clk->time);
+                break;
+            case UNIFORM_TIME_DELTA:
+                glUniform1f(ui->location, (float)clk->delta);
+                break;
+            case UNIFORM_FRAME:
+                glUniform1i(ui->location, (GLint)clk->frame);
+                break;
+            case UNIFORM_RESOLUTION:
+                glUniform2f(ui->location, (float)ctx->width, (float)ctx->height);
+                break;
+            default:
+                break;
+        }
+    }
 
     /* Render */
-    render_quad();
+    begin_gpu_timer(ctx->gpu_timer);
+    render_fullscreen(ctx);
+    end_gpu_timer(ctx->gpu_timer);
     glUseProgram(0);
 }
 
@@ -185,7 +253,8 @@ void render(struct render_context* ctx)
  * -------------------------------------------------- */
 void destroy_renderer(struct render_context* ctx)
 {
+    glDeleteVertexArrays(1, &ctx->fs_vao);
+    glDeleteBuffers(1, &ctx->fs_vbo);
     glDeleteProgram(ctx->program);
-    glDeleteShader(ctx->vert_shader);
-    glDeleteShader(ctx->frag_shader);
+    free_gpu_timer(ctx->gpu_timer);
 }
@@ -31,19 +31,83 @@
 #ifndef _RENDERER_H_
 #define _RENDERER_H_
 #include <glad/glad.h>
+#include "clock.h"
+#include "gputimer.h"
+
+/* Primitive used to cover the screen for the preview pass */
+enum fullscreen_prim
+{
+    FULLSCREEN_TRIANGLE = 0, /* Single oversized triangle, no diagonal seam */
+    FULLSCREEN_QUAD          /* Two triangle strip quad */
+};
+
+/* Maximum number of active uniforms tracked per program */
+#define MAX_UNIFORMS 32
+
+/* Builtin uniform values fed by the renderer */
+enum builtin_uniform
+{
+    UNIFORM_USER = 0,  /* Not fed by the renderer */
+    UNIFORM_TIME,      /* float time */
+    UNIFORM_TIME_DELTA,/* float time_delta */
+    UNIFORM_FRAME,     /* int frame */
+    UNIFORM_RESOLUTION /* vec2 resolution */
+};
+
+/* Reflected active uniform */
+struct uniform_info
+{
+    GLint location;
+    GLenum type;
+    enum builtin_uniform builtin;
+};
+
+/* Per frame renderer statistics */
+struct render_stats
+{
+    /* Number of GL objects created during the previous frame */
+    unsigned int gl_objects_created;
+};
 
 /* Renderer's state data structure */
 struct render_context
 {
     GLuint program;
-    GLuint vert_shader, frag_shader;
+    /* Viewport dimensions */
+    int width, height;
+    /* Active uniforms of the program */
+    struct uniform_info uniforms[MAX_UNIFORMS];
+    unsigned int num_uniforms;
+    /* Persistent fullscreen geometry */
+    GLuint fs_vao, fs_vbo;
+    enum fullscreen_prim fs_prim;
+    /* Statistics gathered for the last completed frame */
+    struct render_stats stats;
+    /* GPU time of the preview pass */
+    gpu_timer_t gpu_timer;
 };
 
-/* Initializes renderer state */
-void init_renderer(struct render_context*);
+/* Initializes renderer state for a viewport of the given size */
+void init_renderer(struct render_context*, int width, int height);
+
+/* Resizes the viewport and the resolution fed to the program */
+void resize_renderer(struct render_context*, int width, int height);
+
+/*
+  Compiles and links a program from the given sources, null sources select
+  the builtin shaders. The current program is replaced only on success,
+  otherwise it keeps rendering and zero is returned
+ */
+int load_shaders(struct render_context*, const char* vert_src, const char* frag_src);
+
+/* Replaces the current program with the given linked one, taking its ownership */
+void set_program(struct render_context*, GLuint program);
+
+/* Renders frame at the given clock's time */
+void render(struct render_context*, const struct shader_clock*);
 
-/* Renders frame */
-void render(struct render_context*);
+/* Selects the primitive used to cover the screen */
+void set_fullscreen_prim(struct render_context*, enum fullscreen_prim);
 
 /* Free's renderer's resources */
 void destroy_renderer(struct render_context*);
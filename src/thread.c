@@ -0,0 +1,188 @@
+#include "thread.h"
+#include <stdlib.h>
+#ifdef _WIN32
+/* Condition variables need Vista or later */
+#if !defined(_WIN32_WINNT) || _WIN32_WINNT < 0x0600
+#undef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* Thread start data */
+struct thread
+{
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    thread_func fn;
+    void* arg;
+};
+
+struct mutex
+{
+#ifdef _WIN32
+    CRITICAL_SECTION cs;
+#else
+    pthread_mutex_t mtx;
+#endif
+};
+
+struct condvar
+{
+#ifdef _WIN32
+    CONDITION_VARIABLE cv;
+#else
+    pthread_cond_t cv;
+#endif
+};
+
+/* =------------------------------------------------------------------------= */
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID arg)
+{
+    struct thread* t = arg;
+    t->fn(t->arg);
+    return 0;
+}
+#else
+static void* thread_entry(void* arg)
+{
+    struct thread* t = arg;
+    t->fn(t->arg);
+    return 0;
+}
+#endif
+
+thread_t thread_create(thread_func fn, void* arg)
+{
+    thread_t t = malloc(sizeof(struct thread));
+    t->fn = fn;
+    t->arg = arg;
+#ifdef _WIN32
+    t->handle = CreateThread(0, 0, thread_entry, t, 0, 0);
+    if (!t->handle)
+#else
+    if (pthread_create(&t->handle, 0, thread_entry, t) != 0)
+#endif
+    {
+        free(t);
+        return 0;
+    }
+    return t;
+}
+
+void thread_join(thread_t t)
+{
+#ifdef _WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->handle, 0);
+#endif
+    free(t);
+}
+
+int cpu_count()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int) si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+#endif
+}
+
+/* =------------------------------------------------------------------------= */
+mutex_t mutex_create()
+{
+    mutex_t m = malloc(sizeof(struct mutex));
+#ifdef _WIN32
+    InitializeCriticalSection(&m->cs);
+#else
+    pthread_mutex_init(&m->mtx, 0);
+#endif
+    return m;
+}
+
+void mutex_destroy(mutex_t m)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(&m->cs);
+#else
+    pthread_mutex_destroy(&m->mtx);
+#endif
+    free(m);
+}
+
+void mutex_lock(mutex_t m)
+{
+#ifdef _WIN32
+    EnterCriticalSection(&m->cs);
+#else
+    pthread_mutex_lock(&m->mtx);
+#endif
+}
+
+void mutex_unlock(mutex_t m)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(&m->cs);
+#else
+    pthread_mutex_unlock(&m->mtx);
+#endif
+}
+
+/* =------------------------------------------------------------------------= */
+condvar_t condvar_create()
+{
+    condvar_t c = malloc(sizeof(struct condvar));
+#ifdef _WIN32
+    InitializeConditionVariable(&c->cv);
+#else
+    pthread_cond_init(&c->cv, 0);
+#endif
+    return c;
+}
+
+void condvar_destroy(condvar_t c)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(&c->cv);
+#endif
+    free(c);
+}
+
+void condvar_wait(condvar_t c, mutex_t m)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(&c->cv, &m->cs, INFINITE);
+#else
+    pthread_cond_wait(&c->cv, &m->mtx);
+#endif
+}
+
+void condvar_signal(condvar_t c)
+{
+#ifdef _WIN32
+    WakeConditionVariable(&c->cv);
+#else
+    pthread_cond_signal(&c->cv);
+#endif
+}
+
+void condvar_broadcast(condvar_t c)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&c->cv);
+#else
+    pthread_cond_broadcast(&c->cv);
+#endif
+}
@@ -0,0 +1,71 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+/* Opaque datatype representing a running thread */
+typedef struct thread* thread_t;
+/* Opaque mutual exclusion lock */
+typedef struct mutex* mutex_t;
+/* Opaque condition variable */
+typedef struct condvar* condvar_t;
+
+/* The thread entry point type */
+typedef void(*thread_func)(void* arg);
+
+/* Starts a new thread running the given function */
+thread_t thread_create(thread_func fn, void* arg);
+/* Waits for the given thread to finish and releases its resources */
+void thread_join(thread_t t);
+/* Retrieves the number of logical processors */
+int cpu_count();
+
+/* Constructs a mutex */
+mutex_t mutex_create();
+/* Destroys a mutex */
+void mutex_destroy(mutex_t m);
+/* Locks a mutex */
+void mutex_lock(mutex_t m);
+/* Unlocks a mutex */
+void mutex_unlock(mutex_t m);
+
+/* Constructs a condition variable */
+condvar_t condvar_create();
+/* Destroys a condition variable */
+void condvar_destroy(condvar_t c);
+/* Atomically unlocks the mutex and waits for the condition to be signaled */
+void condvar_wait(condvar_t c, mutex_t m);
+/* Wakes one waiting thread */
+void condvar_signal(condvar_t c);
+/* Wakes all waiting threads */
+void condvar_broadcast(condvar_t c);
+
+#endif // ! _THREAD_H_
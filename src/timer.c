@@ -1,4 +1,5 @@
 #include "timer.h"
+#ifdef _WIN32
 #include <windows.h>
 
 long long get_timer_precision()
@@ -15,7 +16,43 @@ long long get_timer_value()
     return count.QuadPart;
 }
 
-void sleep(long msec)
+long long get_time_ns()
+{
+    /* Split the conversion so that the multiplication cannot overflow */
+    long long freq = get_timer_precision();
+    long long count = get_timer_value();
+    return (count / freq) * 1000000000LL + ((count % freq) * 1000000000LL) / freq;
+}
+
+void sleep_ms(long msec)
 {
     Sleep(msec);
 }
+#else
+#include <time.h>
+
+long long get_timer_precision()
+{
+    return 1000000000LL;
+}
+
+long long get_timer_value()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+long long get_time_ns()
+{
+    return get_timer_value();
+}
+
+void sleep_ms(long msec)
+{
+    struct timespec ts;
+    ts.tv_sec = msec / 1000;
+    ts.tv_nsec = (msec % 1000) * 1000000L;
+    nanosleep(&ts, 0);
+}
+#endif
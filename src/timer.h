@@ -40,7 +40,10 @@ time_val_t get_timer_precision();
 /* Retrieves the timer current value in counts */
 time_val_t get_timer_value();
 
+/* Retrieves a monotonic timestamp in nanoseconds */
+time_val_t get_time_ns();
+
 /* Suspends the execution of the current thread for the given milliseconds */
-void sleep(long msec);
+void sleep_ms(long msec);
 
 #endif // ! _TIMER_H_
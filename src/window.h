@@ -31,23 +31,21 @@
 #ifndef _WINDOW_H_
 #define _WINDOW_H_
 
-#include <windows.h>
 #include "input.h"
 
-/* Window internal data */
-struct wnd_internal
-{
-    HWND hwnd;       /* The window handle */
-    HGLRC context;   /* The opengl context handle */
-    HDC hdc;         /* The window device context */
-    int keymap[512]; /* The keycode mappings */
-};
+/* Window internal data, defined by each platform backend */
+struct wnd_internal;
+
+/* Opaque opengl context sharing objects with a window's context */
+typedef struct shared_context* shared_context_t;
 
 /* Per window structure */
 struct window
 {
     /* The internal window data */
-    struct wnd_internal internal;
+    struct wnd_internal* internal;
+    /* Framebuffer dimensions */
+    int width, height;
     /* Holds the pressed state of the keyboard keys */
     char keys[KEY_LAST + 1];
     /* Holds the pressed state of the mouse keys */
@@ -73,6 +71,31 @@ int window_should_close(struct window* wnd);
 /* Swaps front and back buffer */
 void swap_buffers(struct window* wnd);
 
+/*
+  Sets the number of vertical blanks a swap waits for, zero disables
+  vsync and a negative value swaps late frames immediately (adaptive
+  vsync). Returns zero if the platform does not support the interval
+ */
+int set_swap_interval(struct window* wnd, int interval);
+
+/* Retrieves the address of an opengl function, including ones beyond the loaded core profile */
+void* get_gl_proc_address(const char* name);
+
+/*
+  Creates an opengl context that shares objects with the window's one.
+  Returns null when the platform cannot provide one
+ */
+shared_context_t create_shared_context(struct window* wnd);
+
+/* Binds the shared context to the calling thread, returns zero on failure */
+int make_shared_context_current(shared_context_t ctx);
+
+/* Unbinds the shared context from the calling thread */
+void release_shared_context(shared_context_t ctx);
+
+/* Destroys a shared context, it must not be current in any thread */
+void destroy_shared_context(shared_context_t ctx);
+
 /* Checks the pressed state of the given key */
 int is_key_pressed(struct window* wnd, enum key k);
 
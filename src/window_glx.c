@@ -0,0 +1,349 @@
+#if !defined(_WIN32) && !defined(SHADERVIEW_HEADLESS)
+#include "window.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <GL/glx.h>
+#include <GL/glxext.h>
+
+/* Window internal data */
+struct wnd_internal
+{
+    Display* display;     /* The X server connection */
+    Window window;        /* The window handle */
+    Colormap colormap;    /* The colormap of the window's visual */
+    GLXContext context;   /* The opengl context handle */
+    GLXFBConfig config;   /* The framebuffer config the context was created with */
+    Atom wm_delete;       /* The window manager close request atom */
+    int keymap[512];      /* The keycode mappings */
+    PFNGLXCREATECONTEXTATTRIBSARBPROC glXCreateContextAttribsARB;
+    PFNGLXSWAPINTERVALEXTPROC glXSwapIntervalEXT; /* Null without GLX_EXT_swap_control */
+    int swap_tear;        /* Non zero if negative swap intervals are supported */
+};
+
+/* Shared context data */
+struct shared_context
+{
+    Display* display;     /* The X server connection of the owning window */
+    GLXContext context;   /* The opengl context handle */
+    GLXPbuffer pbuffer;   /* Dummy drawable to make the context current on */
+};
+
+/* Context attributes of the main and the shared contexts */
+static const int ctx_attribs[] =
+{
+    GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+    GLX_CONTEXT_MINOR_VERSION_ARB, 3,
+    GLX_CONTEXT_FLAGS_ARB, 0,
+    GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+    None
+};
+
+struct glx_extension_funcs
+{
+    PFNGLXCREATECONTEXTATTRIBSARBPROC glXCreateContextAttribsARB;
+    PFNGLXSWAPINTERVALEXTPROC glXSwapIntervalEXT;
+};
+
+static void initialize_opengl_extensions(struct glx_extension_funcs* funcs)
+{
+    funcs->glXCreateContextAttribsARB = (PFNGLXCREATECONTEXTATTRIBSARBPROC) glXGetProcAddressARB((const GLubyte*) "glXCreateContextAttribsARB");
+    funcs->glXSwapIntervalEXT = (PFNGLXSWAPINTERVALEXTPROC) glXGetProcAddressARB((const GLubyte*) "glXSwapIntervalEXT");
+}
+
+static int has_glx_extension(Display* dpy, const char* name)
+{
+    const char* exts = glXQueryExtensionsString(dpy, DefaultScreen(dpy));
+    size_t len = strlen(name);
+    while (exts && (exts = strstr(exts, name)) != 0)
+    {
+        if (exts[len] == ' ' || exts[len] == '\0')
+            return 1;
+        exts += len;
+    }
+    return 0;
+}
+
+static GLXFBConfig choose_fb_config(Display* dpy)
+{
+    /* Pixel format hints */
+    int fb_attribs[] =
+    {
+        GLX_X_RENDERABLE,  True,
+        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT | GLX_PBUFFER_BIT,
+        GLX_RENDER_TYPE,   GLX_RGBA_BIT,
+        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+        GLX_RED_SIZE,      8,
+        GLX_GREEN_SIZE,    8,
+        GLX_BLUE_SIZE,     8,
+        GLX_ALPHA_SIZE,    8,
+        GLX_DEPTH_SIZE,    24,
+        GLX_STENCIL_SIZE,  8,
+        GLX_DOUBLEBUFFER,  True,
+        None
+    };
+
+    /* Configs are returned sorted by preference, take the first */
+    int num_configs = 0;
+    GLXFBConfig* configs = glXChooseFBConfig(dpy, DefaultScreen(dpy), fb_attribs, &num_configs);
+    if (!configs || num_configs == 0)
+        return 0;
+    GLXFBConfig config = configs[0];
+    XFree(configs);
+    return config;
+}
+
+static int create_window(struct window* wnd, GLXFBConfig config)
+{
+    struct wnd_internal* wi = wnd->internal;
+    Display* dpy = wi->display;
+
+    XVisualInfo* vi = glXGetVisualFromFBConfig(dpy, config);
+    if (!vi)
+        return 0;
+
+    /* Window attributes */
+    XSetWindowAttributes swa;
+    memset(&swa, 0, sizeof(swa));
+    wi->colormap = XCreateColormap(dpy, RootWindow(dpy, vi->screen), vi->visual, AllocNone);
+    swa.colormap = wi->colormap;
+    swa.border_pixel = 0;
+    swa.event_mask = KeyPressMask | KeyReleaseMask | StructureNotifyMask | FocusChangeMask;
+
+    /* Create the Window */
+    wi->window = XCreateWindow(
+        dpy,                                   /* display      */
+        RootWindow(dpy, vi->screen),           /* parent       */
+        0, 0,                                  /* x, y         */
+        wnd->width, wnd->height,               /* width/height */
+        0,                                     /* border width */
+        vi->depth,                             /* depth        */
+        InputOutput,                           /* class        */
+        vi->visual,                            /* visual       */
+        CWBorderPixel | CWColormap | CWEventMask,
+        &swa
+    );
+    XFree(vi);
+    if (!wi->window)
+        return 0;
+
+    /* Ask the window manager to notify us on close instead of killing the connection */
+    wi->wm_delete = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(dpy, wi->window, &wi->wm_delete, 1);
+
+    XStoreName(dpy, wi->window, "ShaderView");
+    XMapWindow(dpy, wi->window);
+    return 1;
+}
+
+static int create_opengl_context(struct window* wnd, GLXFBConfig config)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    /* Holder for the glx extension functions */
+    struct glx_extension_funcs glx;
+    initialize_opengl_extensions(&glx);
+    if (!glx.glXCreateContextAttribsARB)
+        return 0;
+
+    /* Create context using extension and make it current */
+    wi->context = glx.glXCreateContextAttribsARB(wi->display, config, 0, True, ctx_attribs);
+    if (!wi->context)
+        return 0;
+    wi->config = config;
+    wi->glXCreateContextAttribsARB = glx.glXCreateContextAttribsARB;
+    glXMakeCurrent(wi->display, wi->window, wi->context);
+
+    /* Sync to vblank */
+    if (glx.glXSwapIntervalEXT && has_glx_extension(wi->display, "GLX_EXT_swap_control"))
+    {
+        wi->glXSwapIntervalEXT = glx.glXSwapIntervalEXT;
+        wi->swap_tear = has_glx_extension(wi->display, "GLX_EXT_swap_control_tear");
+        wi->glXSwapIntervalEXT(wi->display, wi->window, 1);
+    }
+
+    /* Load core profile functions */
+    gladLoadGL();
+    return 1;
+}
+
+int window_should_close(struct window* wnd)
+{
+    return wnd->should_close;
+}
+
+static void populate_scan_map(struct window* window)
+{
+    populate_keycode_map(window->internal->keymap, 512);
+}
+
+void open_window(struct window* window)
+{
+    /* Allocate platform data */
+    window->internal = calloc(1, sizeof(struct wnd_internal));
+    window->width = 800;
+    window->height = 600;
+    window->should_close = 1;
+
+    /* Populate the internal keyscan map */
+    populate_scan_map(window);
+
+    /* Clear the key state */
+    memset(window->keys, 0, KEY_LAST + 1);
+
+    /* Shared contexts may be driven from worker threads */
+    XInitThreads();
+
+    /* Connect to the X server */
+    struct wnd_internal* wi = window->internal;
+    wi->display = XOpenDisplay(0);
+    if (!wi->display)
+    {
+        fprintf(stderr, "Could not connect to X server\n");
+        return;
+    }
+
+    /* Report key repeats as presses only, instead of release/press pairs */
+    XkbSetDetectableAutoRepeat(wi->display, True, 0);
+
+    /* Create the window instance and its opengl context */
+    GLXFBConfig config = choose_fb_config(wi->display);
+    if (!config || !create_window(window, config))
+    {
+        fprintf(stderr, "Could not create window with a matching GLX framebuffer config\n");
+        return;
+    }
+    if (!create_opengl_context(window, config))
+    {
+        fprintf(stderr, "Could not create OpenGL 3.3 core context\n");
+        return;
+    }
+
+    /* Keep it open */
+    window->should_close = 0;
+}
+
+void poll_window_events(struct window* window)
+{
+    struct wnd_internal* wi = window->internal;
+
+    /* Drain queued events without blocking */
+    while (XPending(wi->display))
+    {
+        XEvent ev;
+        XNextEvent(wi->display, &ev);
+        switch (ev.type)
+        {
+            case ClientMessage:
+            {
+                if ((Atom) ev.xclient.data.l[0] == wi->wm_delete)
+                    window->should_close = 1;
+                break;
+            }
+            case KeyPress:
+            case KeyRelease:
+            {
+                /* Translate system keycode to our key value */
+                int key = wi->keymap[ev.xkey.keycode & 0x1FF];
+                if (key == KEY_UNKNOWN)
+                    break;
+
+                /* Set the pressed state of the current key */
+                window->keys[key] = (ev.type == KeyPress) ? 1 : 0;
+                break;
+            }
+            case ConfigureNotify:
+            {
+                window->width = ev.xconfigure.width;
+                window->height = ev.xconfigure.height;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+void close_window(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    /* Release resources */
+    if (wi->display)
+    {
+        if (wi->context)
+        {
+            glXMakeCurrent(wi->display, None, 0);
+            glXDestroyContext(wi->display, wi->context);
+        }
+        if (wi->window)
+            XDestroyWindow(wi->display, wi->window);
+        if (wi->colormap)
+            XFreeColormap(wi->display, wi->colormap);
+        XCloseDisplay(wi->display);
+    }
+    free(wi);
+    wnd->internal = 0;
+}
+
+void swap_buffers(struct window* wnd)
+{
+    glXSwapBuffers(wnd->internal->display, wnd->internal->window);
+}
+
+int set_swap_interval(struct window* wnd, int interval)
+{
+    struct wnd_internal* wi = wnd->internal;
+    if (!wi->glXSwapIntervalEXT || (interval < 0 && !wi->swap_tear))
+        return 0;
+    wi->glXSwapIntervalEXT(wi->display, wi->window, interval);
+    return 1;
+}
+
+void* get_gl_proc_address(const char* name)
+{
+    return (void*) glXGetProcAddressARB((const GLubyte*) name);
+}
+
+shared_context_t create_shared_context(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+    GLXContext context = wi->glXCreateContextAttribsARB(wi->display, wi->config, wi->context, True, ctx_attribs);
+    if (!context)
+        return 0;
+
+    /* Core contexts may need a drawable to become current on */
+    const int pb_attribs[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+    shared_context_t sc = malloc(sizeof(struct shared_context));
+    sc->display = wi->display;
+    sc->context = context;
+    sc->pbuffer = glXCreatePbuffer(wi->display, wi->config, pb_attribs);
+    return sc;
+}
+
+int make_shared_context_current(shared_context_t sc)
+{
+    return glXMakeContextCurrent(sc->display, sc->pbuffer, sc->pbuffer, sc->context) == True;
+}
+
+void release_shared_context(shared_context_t sc)
+{
+    glXMakeContextCurrent(sc->display, None, None, 0);
+}
+
+void destroy_shared_context(shared_context_t sc)
+{
+    glXDestroyContext(sc->display, sc->context);
+    if (sc->pbuffer)
+        glXDestroyPbuffer(sc->display, sc->pbuffer);
+    free(sc);
+}
+
+int is_key_pressed(struct window* wnd, enum key k)
+{
+    return wnd->keys[k];
+}
+#endif
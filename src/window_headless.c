@@ -0,0 +1,411 @@
+#ifdef SHADERVIEW_HEADLESS
+#include "window.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <glad/glad.h>
+#include <stb_image_write.h>
+#include "timer.h"
+#include "glcount.h"
+
+/* Environment variables configuring the headless backend */
+#define HEADLESS_SIZE_ENV   "SHADERVIEW_SIZE"   /* Framebuffer size as WxH */
+#define HEADLESS_FRAMES_ENV "SHADERVIEW_FRAMES" /* Number of frames to render before closing */
+#define HEADLESS_OUTPUT_ENV "SHADERVIEW_OUTPUT" /* printf pattern of the written frames, e.g. out/%04lu.png */
+
+/* Context attributes of the main and the shared contexts */
+static const EGLint ctx_attribs[] =
+{
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+};
+
+/* Shared context data */
+struct shared_context
+{
+    EGLDisplay display;
+    EGLContext context;
+};
+
+/* Window internal data */
+struct wnd_internal
+{
+    EGLDisplay display;         /* The egl display connection */
+    EGLContext context;         /* The opengl context handle */
+    EGLConfig config;           /* The config the context was created with */
+    GLuint fbo;                 /* Offscreen framebuffer standing in for the window */
+    GLuint color_rb, depth_rb;  /* Framebuffer attachments */
+    unsigned char* pixels;      /* Readback buffer for written frames */
+    unsigned char* row;         /* Scratch row for flipping the readback */
+    char* output;               /* Checked output filename pattern, null when frames are discarded */
+    unsigned long frame;        /* Number of presented frames */
+    unsigned long max_frames;   /* Frames to present before marking the window for closing */
+    time_val_t start;           /* Timer value at the end of the first presented frame */
+    time_val_t write_time;      /* Time spent writing frames since start, left out of the throughput */
+};
+
+static EGLDisplay open_egl_display()
+{
+    /* Prefer the mesa surfaceless platform, it needs neither a display server nor a gpu */
+    const char* client_exts = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (client_exts && strstr(client_exts, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (eglGetPlatformDisplayEXT)
+            return eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static int create_opengl_context(struct wnd_internal* wi)
+{
+    /* Initialize display connection */
+    wi->display = open_egl_display();
+    if (wi->display == EGL_NO_DISPLAY || !eglInitialize(wi->display, 0, 0))
+    {
+        fprintf(stderr, "Headless: could not initialize EGL display\n");
+        return 0;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    /* Rendering goes to our own framebuffer, so any opengl capable config will do */
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint num_configs = 0;
+    const EGLint cfg_attribs[] =
+    {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    eglChooseConfig(wi->display, cfg_attribs, &config, 1, &num_configs);
+    if (num_configs == 0)
+        config = EGL_NO_CONFIG_KHR;
+    wi->config = config;
+
+    /* Create context and make it current without any surface */
+    wi->context = eglCreateContext(wi->display, config, EGL_NO_CONTEXT, ctx_attribs);
+    if (wi->context == EGL_NO_CONTEXT
+     || !eglMakeCurrent(wi->display, EGL_NO_SURFACE, EGL_NO_SURFACE, wi->context))
+    {
+        fprintf(stderr, "Headless: could not create surfaceless OpenGL 3.3 context\n");
+        return 0;
+    }
+
+    /* Load core profile functions */
+    gladLoadGLLoader((GLADloadproc) eglGetProcAddress);
+    return 1;
+}
+
+static void create_framebuffer(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    gen_gl_renderbuffers(1, &wi->color_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, wi->color_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, wnd->width, wnd->height);
+
+    gen_gl_renderbuffers(1, &wi->depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, wi->depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, wnd->width, wnd->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    /* Keep it bound for the whole lifetime, it replaces the default framebuffer */
+    gen_gl_framebuffers(1, &wi->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, wi->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, wi->color_rb);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, wi->depth_rb);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        fprintf(stderr, "Headless: offscreen framebuffer incomplete\n");
+    glViewport(0, 0, wnd->width, wnd->height);
+}
+
+/*
+  Copies a frame filename pattern, rewriting its conversion for the unsigned
+  long frame number whatever its length modifier. Returns zero if the pattern
+  has another conversion than d, i or u, or more than one
+ */
+static int check_output_pattern(const char* pattern, char* out, size_t sz)
+{
+    int conversions = 0;
+    size_t n = 0;
+    for (const char* p = pattern; *p; ++p)
+    {
+        /* Room for the longest piece written at once, a conversion takes at most 25 bytes */
+        if (n + 32 >= sz)
+            return 0;
+        if (*p != '%')
+        {
+            out[n++] = *p;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            out[n++] = *p++;
+            out[n++] = *p;
+            continue;
+        }
+
+        /* Flags, width and precision are kept, length modifiers dropped */
+        out[n++] = *p++;
+        for (int flags = 0; *p && strchr("-+ #0", *p); ++flags)
+        {
+            if (flags == 5)
+                return 0;
+            out[n++] = *p++;
+        }
+        for (int digits = 0; *p >= '0' && *p <= '9'; ++digits)
+        {
+            if (digits == 8)
+                return 0;
+            out[n++] = *p++;
+        }
+        if (*p == '.')
+        {
+            out[n++] = *p++;
+            for (int digits = 0; *p >= '0' && *p <= '9'; ++digits)
+            {
+                if (digits == 8)
+                    return 0;
+                out[n++] = *p++;
+            }
+        }
+        while (*p && strchr("hljz", *p))
+            ++p;
+        if (!*p || !strchr("diu", *p) || ++conversions > 1)
+            return 0;
+        out[n++] = 'l';
+        out[n++] = 'u';
+    }
+    out[n] = 0;
+    return 1;
+}
+
+/* Reads the backend's configuration from the environment, returns zero if it is unusable */
+static int read_config(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    /* Defaults */
+    wnd->width = 800;
+    wnd->height = 600;
+    wi->max_frames = 1;
+    wi->output = 0;
+
+    const char* size = getenv(HEADLESS_SIZE_ENV);
+    if (size)
+    {
+        int w, h;
+        if (sscanf(size, "%dx%d", &w, &h) == 2 && w > 0 && h > 0)
+        {
+            wnd->width = w;
+            wnd->height = h;
+        }
+        else
+            fprintf(stderr, "Headless: ignoring malformed %s=%s\n", HEADLESS_SIZE_ENV, size);
+    }
+
+    const char* frames = getenv(HEADLESS_FRAMES_ENV);
+    if (frames)
+        wi->max_frames = strtoul(frames, 0, 10);
+
+    const char* output = getenv(HEADLESS_OUTPUT_ENV);
+    if (output && *output)
+    {
+        char pattern[1024];
+        if (!check_output_pattern(output, pattern, sizeof(pattern)))
+        {
+            fprintf(stderr, "Headless: %s=%s must hold at most one integer conversion, e.g. %%04lu\n",
+                    HEADLESS_OUTPUT_ENV, output);
+            return 0;
+        }
+        wi->output = malloc(strlen(pattern) + 1);
+        strcpy(wi->output, pattern);
+    }
+    return 1;
+}
+
+static void write_frame(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+    const int stride = wnd->width * 4;
+
+    /* Fetch framebuffer contents */
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, wnd->width, wnd->height, GL_RGBA, GL_UNSIGNED_BYTE, wi->pixels);
+
+    /* Flip to top down row order */
+    unsigned char* row = wi->row;
+    for (int y = 0; y < wnd->height / 2; ++y)
+    {
+        unsigned char* top = wi->pixels + y * stride;
+        unsigned char* bottom = wi->pixels + (wnd->height - 1 - y) * stride;
+        memcpy(row, top, stride);
+        memcpy(top, bottom, stride);
+        memcpy(bottom, row, stride);
+    }
+
+    /* Write it out in the format given by the pattern's extension */
+    char filename[1024];
+    snprintf(filename, sizeof(filename), wi->output, wi->frame);
+    const char* ext = strrchr(filename, '.');
+    int ok;
+    if (ext && strcmp(ext, ".bmp") == 0)
+        ok = stbi_write_bmp(filename, wnd->width, wnd->height, 4, wi->pixels);
+    else if (ext && strcmp(ext, ".tga") == 0)
+        ok = stbi_write_tga(filename, wnd->width, wnd->height, 4, wi->pixels);
+    else
+        ok = stbi_write_png(filename, wnd->width, wnd->height, 4, wi->pixels, stride);
+    if (!ok)
+        fprintf(stderr, "Headless: could not write %s\n", filename);
+}
+
+int window_should_close(struct window* wnd)
+{
+    return wnd->should_close;
+}
+
+void open_window(struct window* window)
+{
+    /* Allocate platform data */
+    window->internal = calloc(1, sizeof(struct wnd_internal));
+
+    /* Clear the key state */
+    memset(window->keys, 0, KEY_LAST + 1);
+    window->should_close = !read_config(window);
+    if (window->should_close)
+        return;
+
+    /* Create opengl context and the framebuffer standing in for the window */
+    window->should_close = !create_opengl_context(window->internal);
+    if (window->should_close)
+        return;
+    create_framebuffer(window);
+
+    /* Readback storage for written frames */
+    if (window->internal->output)
+    {
+        window->internal->pixels = malloc(window->width * window->height * 4);
+        window->internal->row = malloc(window->width * 4);
+    }
+}
+
+void poll_window_events(struct window* window)
+{
+    /* No event source */
+    (void) window;
+}
+
+void close_window(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    /*
+      Report rasterization throughput. The first frame carries driver warmup
+      and is left out, as is the time spent writing frames
+     */
+    if (wi->frame > 1)
+    {
+        glFinish();
+        unsigned long frames = wi->frame - 1;
+        double secs = (double)(get_timer_value() - wi->start - wi->write_time) / get_timer_precision();
+        double pixels = (double)wnd->width * wnd->height * frames;
+        printf("Headless: %lu frames at %dx%d in %.3f s%s, %.3f ms/frame, %.2f Mpix/s\n",
+               frames, wnd->width, wnd->height, secs, wi->output ? " without frame writes" : "",
+               secs * 1000.0 / frames, secs > 0.0 ? pixels / secs / 1e6 : 0.0);
+    }
+
+    /* Release resources */
+    if (wi->context != EGL_NO_CONTEXT)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &wi->fbo);
+        glDeleteRenderbuffers(1, &wi->color_rb);
+        glDeleteRenderbuffers(1, &wi->depth_rb);
+        eglMakeCurrent(wi->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(wi->display, wi->context);
+    }
+    if (wi->display != EGL_NO_DISPLAY)
+        eglTerminate(wi->display);
+    free(wi->pixels);
+    free(wi->row);
+    free(wi->output);
+    free(wi);
+    wnd->internal = 0;
+}
+
+void swap_buffers(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+
+    /* Writes wait for the frame to finish rendering, then only the readback and encoding are left out */
+    if (wi->output)
+    {
+        glFinish();
+        time_val_t write_start = get_timer_value();
+        write_frame(wnd);
+        if (wi->frame > 0)
+            wi->write_time += get_timer_value() - write_start;
+    }
+
+    /* Throughput is measured after the first frame completes */
+    if (wi->frame++ == 0)
+    {
+        glFinish();
+        wi->start = get_timer_value();
+    }
+
+    /* Batch run done */
+    if (wi->max_frames != 0 && wi->frame >= wi->max_frames)
+        wnd->should_close = 1;
+}
+
+int set_swap_interval(struct window* wnd, int interval)
+{
+    /* Frames are never presented, so swaps cannot wait for anything */
+    (void) wnd;
+    return interval == 0;
+}
+
+void* get_gl_proc_address(const char* name)
+{
+    return (void*) eglGetProcAddress(name);
+}
+
+shared_context_t create_shared_context(struct window* wnd)
+{
+    struct wnd_internal* wi = wnd->internal;
+    EGLContext context = eglCreateContext(wi->display, wi->config, wi->context, ctx_attribs);
+    if (context == EGL_NO_CONTEXT)
+        return 0;
+
+    shared_context_t sc = malloc(sizeof(struct shared_context));
+    sc->display = wi->display;
+    sc->context = context;
+    return sc;
+}
+
+int make_shared_context_current(shared_context_t sc)
+{
+    return eglMakeCurrent(sc->display, EGL_NO_SURFACE, EGL_NO_SURFACE, sc->context) == EGL_TRUE;
+}
+
+void release_shared_context(shared_context_t sc)
+{
+    eglMakeCurrent(sc->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void destroy_shared_context(shared_context_t sc)
+{
+    eglDestroyContext(sc->display, sc->context);
+    free(sc);
+}
+
+int is_key_pressed(struct window* wnd, enum key k)
+{
+    return wnd->keys[k];
+}
+#endif
@@ -1,8 +1,40 @@
+#if defined(_WIN32) && !defined(SHADERVIEW_HEADLESS)
 #include "window.h"
+#include <stdlib.h>
+#include <string.h>
 #include <windows.h>
 #include <glad/glad.h>
 #include <GL/wglext.h>
 
+/* Window internal data */
+struct wnd_internal
+{
+    HWND hwnd;       /* The window handle */
+    HGLRC context;   /* The opengl context handle */
+    HDC hdc;         /* The window device context */
+    int keymap[512]; /* The keycode mappings */
+    PFNWGLCREATECONTEXTATTRIBSARBPROC wglCreateContextAttribsARB;
+    PFNWGLSWAPINTERVALEXTPROC wglSwapIntervalEXT;
+    int swap_tear;   /* Non zero if negative swap intervals are supported */
+};
+
+/* Shared context data */
+struct shared_context
+{
+    HDC hdc;         /* The device context of the owning window */
+    HGLRC context;   /* The opengl context handle */
+};
+
+/* Context attributes of the main and the shared contexts */
+static const int ctx_attribs[] =
+{
+    WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
+    WGL_CONTEXT_MINOR_VERSION_ARB, 3,
+    WGL_CONTEXT_FLAGS_ARB, 0,
+    WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+    0
+};
+
 /* The window class unique identifier */
 const char* window_class_name = "shader_view_window";
 
@@ -65,25 +97,26 @@ static void create_opengl_context(struct window* wnd)
     struct wgl_extension_funcs wgl = {0};
 
     /* Creates a temp context in order to load opengl functions */
-    initialize_opengl_extensions(wnd->internal.hwnd, &wgl);
+    initialize_opengl_extensions(wnd->internal->hwnd, &wgl);
 
     /* Get the Device Context */
-    wnd->internal.hdc = GetDC(wnd->internal.hwnd);
+    wnd->internal->hdc = GetDC(wnd->internal->hwnd);
 
     /* Choose pixel format using extension */
     //wgl.wgtChoo
 
     /* Create context using extension and make it current */
-    int ctx_attribs[] =
+    wnd->internal->context = (HGLRC) wgl.wglCreateContextAttribsARB(wnd->internal->hdc, 0, ctx_attribs);
+    wnd->internal->wglCreateContextAttribsARB = wgl.wglCreateContextAttribsARB;
+    wglMakeCurrent(wnd->internal->hdc, wnd->internal->context);
+
+    /* Swap control */
+    wnd->internal->wglSwapIntervalEXT = wgl.wglSwapIntervalEXT;
+    if (wgl.wglGetExtensionsStringEXT)
     {
-        WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
-        WGL_CONTEXT_MINOR_VERSION_ARB, 3,
-        WGL_CONTEXT_FLAGS_ARB, 0,
-        WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
-        0
-    };
-    wnd->internal.context = (HGLRC) wgl.wglCreateContextAttribsARB(wnd->internal.hdc, 0, ctx_attribs);
-    wglMakeCurrent(wnd->internal.hdc, wnd->internal.context);
+        const char* exts = wgl.wglGetExtensionsStringEXT();
+        wnd->internal->swap_tear = exts && strstr(exts, "WGL_EXT_swap_control_tear") != 0;
+    }
 
     /* Load core profile functions */
     gladLoadGL();
@@ -121,7 +154,7 @@ static LRESULT CALLBACK window_callback_func(HWND hh, UINT mm, WPARAM ww, LPARAM
             const int action = (ll >> 31 & 1) ? KEY_ACTION_RELEASE : KEY_ACTION_PRESS;
 
             /* Translate system keycode to our key value */
-            int key = wnd->internal.keymap[scancode];
+            int key = wnd->internal->keymap[scancode];
 
             /* Set the pressed state of the current key */
             wnd->keys[key] = (action == KEY_ACTION_PRESS) ? 1 : 0;
@@ -180,7 +213,7 @@ static HWND create_window(struct window* wnd)
 
 static void populate_scan_map(struct window* window)
 {
-    populate_keycode_map((int*)window->internal.keymap, 512);
+    populate_keycode_map((int*)window->internal->keymap, 512);
 }
 
 void open_window(struct window* window)
@@ -188,6 +221,9 @@ void open_window(struct window* window)
     /* Window handle and window message */
     HWND hwnd;
 
+    /* Allocate platform data */
+    window->internal = calloc(1, sizeof(struct wnd_internal));
+
     /* Populate the internal keyscan map */
     populate_scan_map(window);
 
@@ -198,7 +234,9 @@ void open_window(struct window* window)
     hwnd = create_window(window);
 
     /* Store the window handle */
-    window->internal.hwnd = hwnd;
+    window->internal->hwnd = hwnd;
+    window->width = 800;
+    window->height = 600;
 
     /* Create opengl context */
     create_opengl_context(window);
@@ -213,7 +251,7 @@ void poll_window_events(struct window* window)
     MSG msg;
 
     /* Peek message loop, poll for events */
-    while(PeekMessage(&msg, window->internal.hwnd, 0, 0, PM_REMOVE))
+    while(PeekMessage(&msg, window->internal->hwnd, 0, 0, PM_REMOVE))
     {
         TranslateMessage(&msg);
         DispatchMessage(&msg);
@@ -223,17 +261,63 @@ void poll_window_events(struct window* window)
 void close_window(struct window* wnd)
 {
     /* Release resources */
-    wglMakeCurrent(wnd->internal.hdc, 0);
-    wglDeleteContext(wnd->internal.context);
-    ReleaseDC(wnd->internal.hwnd, wnd->internal.hdc);
+    wglMakeCurrent(wnd->internal->hdc, 0);
+    wglDeleteContext(wnd->internal->context);
+    ReleaseDC(wnd->internal->hwnd, wnd->internal->hdc);
+    free(wnd->internal);
+    wnd->internal = 0;
 }
 
 void swap_buffers(struct window* wnd)
 {
-    SwapBuffers(wnd->internal.hdc);
+    SwapBuffers(wnd->internal->hdc);
+}
+
+int set_swap_interval(struct window* wnd, int interval)
+{
+    struct wnd_internal* wi = wnd->internal;
+    if (!wi->wglSwapIntervalEXT || (interval < 0 && !wi->swap_tear))
+        return 0;
+    return wi->wglSwapIntervalEXT(interval) == TRUE;
+}
+
+void* get_gl_proc_address(const char* name)
+{
+    return (void*) wglGetProcAddress(name);
+}
+
+shared_context_t create_shared_context(struct window* wnd)
+{
+    HGLRC context = (HGLRC) wnd->internal->wglCreateContextAttribsARB(wnd->internal->hdc, wnd->internal->context, ctx_attribs);
+    if (!context)
+        return 0;
+
+    shared_context_t sc = malloc(sizeof(struct shared_context));
+    sc->hdc = wnd->internal->hdc;
+    sc->context = context;
+    return sc;
+}
+
+int make_shared_context_current(shared_context_t sc)
+{
+    /* The window's pixel format is already set, its device context can be shared across threads */
+    return wglMakeCurrent(sc->hdc, sc->context) == TRUE;
+}
+
+void release_shared_context(shared_context_t sc)
+{
+    (void) sc;
+    wglMakeCurrent(0, 0);
+}
+
+void destroy_shared_context(shared_context_t sc)
+{
+    wglDeleteContext(sc->context);
+    free(sc);
 }
 
 int is_key_pressed(struct window* wnd, enum key k)
 {
     return wnd->keys[k];
 }
+#endif
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assetload.h"
+#include "blend.h"
+#include "font.h"
+#include "thread.h"
+#include "timer.h"
+
+/*
+  Times CPU side stages of ShaderView on their own and checks that their
+  results do not depend on how they ran.
+  Usage: bench [font file]
+  Run from the directory ShaderView runs in, the font defaults to its own
+ */
+
+#define FONT_PATH "ext/Beeb.ttf"
+/* Thread count of font bakes, read by font.c at every bake */
+#define BAKE_THREADS_ENV "SHADERVIEW_FONT_THREADS"
+/* Timed runs per measurement, the fastest one is reported */
+#define REPEATS 5
+
+/* Pixel heights and thread counts of the bake scaling table */
+static const float bake_sizes[] = { 16.0f, 32.0f, 64.0f, 128.0f };
+static const int bake_threads[] = { 1, 2, 4, 8 };
+
+/* Frame blended over by the kernel table, and the text covering it */
+#define BLEND_WIDTH 1920
+#define BLEND_HEIGHT 1080
+#define BLEND_TEXT "The quick brown fox jumps over the lazy dog 0123456789"
+#define BLEND_TEXT_HEIGHT 32.0f
+
+/* Fonts kept loaded by the churn loop, rounds of it, and lookups of every live font per round */
+#define CHURN_FONTS 64
+#define CHURN_ROUNDS 2000
+#define CHURN_LOOKUPS 16
+/* Most recently unloaded handles checked for rejection every round */
+#define CHURN_STALE 256
+#define CHURN_FONT_HEIGHT 8.0f
+
+static void set_env(const char* name, const char* value)
+{
+#ifdef _WIN32
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+static double elapsed_ms(time_val_t since)
+{
+    return (double)(get_timer_value() - since) * 1000.0 / get_timer_precision();
+}
+
+/* =------------------------------------------------------------------------= */
+/* Renders every baked glyph of a font on its own, one bitmap after the other */
+static unsigned char* render_baked_glyphs(fontstash_t fs, font_t font, size_t* size)
+{
+    *size = 0;
+    unsigned char* out = 0;
+    for (char c = 32; c < 127; ++c)
+    {
+        const char text[2] = { c, 0 };
+        size_t sz = get_min_buf_size(fs, font, text);
+        out = realloc(out, *size + sz);
+        int width, height;
+        draw_text_mem_buf(fs, font, text, out + *size, &width, &height);
+        *size += sz;
+    }
+    return out;
+}
+
+/*
+  Bakes the font at every size with every thread count, bypassing the baked
+  font cache. Glyphs are compared against the one thread bake of their size.
+  Returns the number of bakes that differ
+ */
+static int bench_font_bake(const char* path, const unsigned char* buf, size_t buf_sz)
+{
+    fontstash_t fs = init_fontstash();
+    enable_font_cache(fs, 0);
+    int mismatches = 0;
+
+    printf("Font bake, %s, printable ASCII, fastest of %d, %d cpus\n", path, REPEATS, cpu_count());
+    printf("  size  threads        ms  speedup  identical\n");
+    for (size_t s = 0; s < sizeof(bake_sizes) / sizeof(bake_sizes[0]); ++s)
+    {
+        double base_ms = 0.0;
+        unsigned char* base = 0;
+        size_t base_size = 0;
+        for (size_t t = 0; t < sizeof(bake_threads) / sizeof(bake_threads[0]); ++t)
+        {
+            char threads[16];
+            snprintf(threads, sizeof(threads), "%d", bake_threads[t]);
+            set_env(BAKE_THREADS_ENV, threads);
+
+            double best_ms = 0.0;
+            unsigned char* glyphs = 0;
+            size_t glyphs_size = 0;
+            for (int r = 0; r < REPEATS; ++r)
+            {
+                time_val_t start = get_timer_value();
+                font_t font = load_font(fs, bake_sizes[s], buf, buf_sz);
+                double ms = elapsed_ms(start);
+                if (!font)
+                {
+                    fprintf(stderr, "Could not load font %s\n", path);
+                    free(base);
+                    free_fontstash(fs);
+                    return mismatches + 1;
+                }
+                if (r == 0 || ms < best_ms)
+                    best_ms = ms;
+                if (r == 0)
+                    glyphs = render_baked_glyphs(fs, font, &glyphs_size);
+                unload_font(fs, font);
+            }
+
+            int identical = 1;
+            if (t == 0)
+            {
+                base = glyphs;
+                base_size = glyphs_size;
+                base_ms = best_ms;
+            }
+            else
+            {
+                identical = glyphs_size == base_size && memcmp(glyphs, base, base_size) == 0;
+                free(glyphs);
+            }
+            mismatches += !identical;
+            printf("  %4.0f  %7d  %8.3f  %6.2fx  %s\n", bake_sizes[s], bake_threads[t],
+                   best_ms, base_ms / best_ms, identical ? "yes" : "NO");
+        }
+        free(base);
+    }
+    free_fontstash(fs);
+    return mismatches;
+}
+
+/* =------------------------------------------------------------------------= */
+/* Fills a frame's coverage by tiling a rendered line of text over it */
+static unsigned char* tile_text_coverage(const unsigned char* buf, size_t buf_sz)
+{
+    fontstash_t fs = init_fontstash();
+    enable_font_cache(fs, 0);
+    font_t font = load_font(fs, BLEND_TEXT_HEIGHT, buf, buf_sz);
+    if (!font)
+    {
+        free_fontstash(fs);
+        return 0;
+    }
+    unsigned char* line = malloc(get_min_buf_size(fs, font, BLEND_TEXT));
+    int width, height;
+    draw_text_mem_buf(fs, font, BLEND_TEXT, line, &width, &height);
+
+    unsigned char* coverage = malloc((size_t) BLEND_WIDTH * BLEND_HEIGHT);
+    for (int y = 0; y < BLEND_HEIGHT; ++y)
+        for (int x = 0; x < BLEND_WIDTH; ++x)
+            coverage[(size_t) y * BLEND_WIDTH + x] = line[(size_t)(y % height) * width + x % width];
+    free(line);
+    free_fontstash(fs);
+    return coverage;
+}
+
+/* Blends a colour over a frame with the given kernel, row by row */
+static void blend_frame(blend_row_fn blend, unsigned char* pixels, size_t pixel_size, const unsigned char* coverage)
+{
+    const float color[3] = { 1.0f, 0.5f, 0.25f };
+    for (int y = 0; y < BLEND_HEIGHT; ++y)
+        blend(pixels + (size_t) y * BLEND_WIDTH * pixel_size, coverage + (size_t) y * BLEND_WIDTH, BLEND_WIDTH, color);
+}
+
+/*
+  Times every row blend kernel the CPU supports over a text covered frame,
+  comparing the pixels of each against the scalar kernel's.
+  Returns the number of kernels that differ
+ */
+static int bench_blend_kernels(const unsigned char* buf, size_t buf_sz)
+{
+    unsigned char* coverage = tile_text_coverage(buf, buf_sz);
+    if (!coverage)
+        return 1;
+    int mismatches = 0;
+
+    printf("Text blend, %dx%d frame covered by %.0f px text, fastest of %d\n",
+           BLEND_WIDTH, BLEND_HEIGHT, BLEND_TEXT_HEIGHT, REPEATS);
+    printf("  format   kernel        ms    Mpix/s  identical\n");
+    const enum pixel_format formats[] = { PIXEL_RGBA8, PIXEL_RGBA32F };
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+    {
+        /* Start every run from the same gradient */
+        size_t pixel_size = formats[f] == PIXEL_RGBA8 ? 4 : 4 * sizeof(float);
+        size_t frame_size = (size_t) BLEND_WIDTH * BLEND_HEIGHT * pixel_size;
+        unsigned char* initial = malloc(frame_size);
+        for (size_t i = 0; i < (size_t) BLEND_WIDTH * BLEND_HEIGHT * 4; ++i)
+        {
+            if (formats[f] == PIXEL_RGBA8)
+                initial[i] = (unsigned char)(i * 7);
+            else
+                ((float*) initial)[i] = (float)(i % 251) / 250.0f;
+        }
+        unsigned char* base = malloc(frame_size);
+        unsigned char* pixels = malloc(frame_size);
+
+        struct blend_kernel kernels[MAX_BLEND_KERNELS];
+        unsigned int num_kernels = get_blend_kernels(formats[f], kernels);
+        for (unsigned int k = 0; k < num_kernels; ++k)
+        {
+            double best_ms = 0.0;
+            for (int r = 0; r < REPEATS; ++r)
+            {
+                memcpy(pixels, initial, frame_size);
+                time_val_t start = get_timer_value();
+                blend_frame(kernels[k].fn, pixels, pixel_size, coverage);
+                double ms = elapsed_ms(start);
+                if (r == 0 || ms < best_ms)
+                    best_ms = ms;
+            }
+
+            int identical = 1;
+            if (k == 0)
+                memcpy(base, pixels, frame_size);
+            else
+                identical = memcmp(pixels, base, frame_size) == 0;
+            mismatches += !identical;
+            printf("  %-7s  %-6s  %8.3f  %8.1f  %s\n", formats[f] == PIXEL_RGBA8 ? "rgba8" : "rgba32f", kernels[k].isa,
+                   best_ms, (double) BLEND_WIDTH * BLEND_HEIGHT / (best_ms * 1000.0), identical ? "yes" : "NO");
+        }
+        free(pixels);
+        free(base);
+        free(initial);
+    }
+    free(coverage);
+    return mismatches;
+}
+
+/* =------------------------------------------------------------------------= */
+/*
+  Keeps a set of fonts loaded while replacing a pseudo random one each round,
+  looking up every live handle in between. Handles of unloaded fonts must be
+  rejected from then on, also once their slot holds a newer font.
+  Returns the number of failed checks
+ */
+static int bench_font_churn(const unsigned char* buf, size_t buf_sz)
+{
+    fontstash_t fs = init_fontstash();
+    enable_font_cache(fs, 0);
+    font_t live[CHURN_FONTS];
+    font_t stale[CHURN_STALE] = {0};
+    unsigned int num_stale = 0;
+    unsigned int seed = 1;
+    int failures = 0;
+    double load_ms = 0.0, unload_ms = 0.0, lookup_ms = 0.0;
+
+    for (int i = 0; i < CHURN_FONTS; ++i)
+        live[i] = load_font(fs, CHURN_FONT_HEIGHT, buf, buf_sz);
+    for (int round = 0; round < CHURN_ROUNDS; ++round)
+    {
+        /* Replace a font */
+        seed = seed * 1103515245u + 12345u;
+        int victim = (int)((seed >> 16) % CHURN_FONTS);
+        font_t old = live[victim];
+        time_val_t start = get_timer_value();
+        unload_font(fs, old);
+        unload_ms += elapsed_ms(start);
+        start = get_timer_value();
+        live[victim] = load_font(fs, CHURN_FONT_HEIGHT, buf, buf_sz);
+        load_ms += elapsed_ms(start);
+        stale[num_stale++ % CHURN_STALE] = old;
+        failures += !live[victim] || live[victim] == old;
+
+        /* Live handles resolve */
+        start = get_timer_value();
+        size_t found = 0;
+        for (int l = 0; l < CHURN_LOOKUPS; ++l)
+            for (int i = 0; i < CHURN_FONTS; ++i)
+                found += get_min_buf_size(fs, live[i], "A") != 0;
+        lookup_ms += elapsed_ms(start);
+        failures += found != (size_t) CHURN_LOOKUPS * CHURN_FONTS;
+
+        /* Stale ones do not, slots are reused so most point at a newer font */
+        for (unsigned int i = 0; i < CHURN_STALE && i < num_stale; ++i)
+            failures += get_min_buf_size(fs, stale[i], "A") != 0;
+    }
+    for (int i = 0; i < CHURN_FONTS; ++i)
+        unload_font(fs, live[i]);
+    free_fontstash(fs);
+
+    printf("Font slot churn, %d fonts, %d rounds, %.0f px\n", CHURN_FONTS, CHURN_ROUNDS, CHURN_FONT_HEIGHT);
+    printf("  load %.3f ms, unload %.3f us, lookup %.1f ns on average\n",
+           load_ms / CHURN_ROUNDS, unload_ms * 1000.0 / CHURN_ROUNDS,
+           lookup_ms * 1e6 / ((double) CHURN_ROUNDS * CHURN_LOOKUPS * CHURN_FONTS));
+    printf("  handle checks: %d failed\n", failures);
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* font_path = argc > 1 ? argv[1] : FONT_PATH;
+    struct asset_view fontfile;
+    if (!open_asset(font_path, ASSET_ACCESS_RANDOM, &fontfile))
+        return 1;
+
+    int failures = bench_font_bake(font_path, fontfile.data, fontfile.size);
+    printf("\n");
+    failures += bench_blend_kernels(fontfile.data, fontfile.size);
+    printf("\n");
+    failures += bench_font_churn(fontfile.data, fontfile.size);
+
+    close_asset(&fontfile);
+    return failures ? 1 : 0;
+}
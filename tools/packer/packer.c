@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "archive.h"
+#include "assetload.h"
+
+/*
+  Packs files into an archive that ShaderView mounts with mount_archive.
+  Usage: packer [-c] <archive> <file>...
+  Files are stored under their paths as given, so pack from the directory
+  ShaderView runs in. -c compresses the entries it makes smaller
+ */
+
+/* A file being packed */
+struct pack_entry
+{
+    char name[ARCHIVE_MAX_PATH];
+    unsigned long long hash;
+    unsigned char* blob;       /* Compressed contents, null when stored */
+    struct asset_view view;
+    struct archive_entry toc;
+};
+
+static int compare_entries(const void* a, const void* b)
+{
+    const struct pack_entry* x = a;
+    const struct pack_entry* y = b;
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+/* Writes zeros up to the next multiple of the alignment */
+static int pad_to(FILE* f, unsigned long long* pos, unsigned long long alignment)
+{
+    static const unsigned char zeros[ARCHIVE_ALIGNMENT] = {0};
+    size_t pad = (size_t)((alignment - *pos % alignment) % alignment);
+    *pos += pad;
+    return fwrite(zeros, 1, pad, f) == pad;
+}
+
+/* Reads a file and compresses it if asked and worth it */
+static int pack_file(struct pack_entry* pe, const char* path, int compress)
+{
+    if (!normalize_archive_path(path, pe->name, sizeof(pe->name)))
+    {
+        fprintf(stderr, "Path too long: %s\n", path);
+        return 0;
+    }
+    if (!open_asset(path, ASSET_ACCESS_SEQUENTIAL, &pe->view))
+        return 0;
+    pe->hash = hash_archive_path(pe->name);
+    pe->toc.hash = pe->hash;
+    pe->toc.raw_size = pe->view.size;
+    pe->toc.size = pe->view.size;
+    pe->toc.compression = ARCHIVE_STORED;
+    if (!compress || pe->view.size == 0)
+        return 1;
+
+    /* Compressed entries cost a decompressed copy per open, keep them for real savings */
+    unsigned char* blob = malloc(max_compressed_size(pe->view.size));
+    size_t size = compress_lz(pe->view.data, pe->view.size, blob);
+    if (size < pe->view.size - pe->view.size / 8)
+    {
+        pe->blob = blob;
+        pe->toc.size = size;
+        pe->toc.compression = ARCHIVE_LZ;
+    }
+    else
+        free(blob);
+    return 1;
+}
+
+/* Writes the archive, entries sorted by hash already */
+static int write_archive(const char* filename, struct pack_entry* entries, unsigned int num_entries)
+{
+    FILE* f = fopen(filename, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Could not write %s\n", filename);
+        return 0;
+    }
+
+    struct archive_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = ARCHIVE_MAGIC;
+    hdr.version = ARCHIVE_VERSION;
+    hdr.num_entries = num_entries;
+    hdr.bucket_bits = 1;
+    while ((1u << hdr.bucket_bits) < num_entries)
+        hdr.bucket_bits++;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+
+    /* Blobs */
+    unsigned long long pos = sizeof(hdr);
+    for (unsigned int i = 0; i < num_entries && ok; ++i)
+    {
+        struct pack_entry* pe = entries + i;
+        ok = pad_to(f, &pos, ARCHIVE_ALIGNMENT);
+        pe->toc.offset = pos;
+        const void* data = pe->blob ? pe->blob : (const void*) pe->view.data;
+        ok = ok && fwrite(data, 1, (size_t) pe->toc.size, f) == pe->toc.size;
+        pos += pe->toc.size;
+    }
+
+    /* Table of contents */
+    ok = ok && pad_to(f, &pos, ARCHIVE_ALIGNMENT);
+    hdr.toc_offset = pos;
+    for (unsigned int i = 0; i < num_entries && ok; ++i)
+    {
+        struct pack_entry* pe = entries + i;
+        pe->toc.name_offset = (unsigned int) hdr.names_size;
+        pe->toc.name_length = (unsigned int) strlen(pe->name);
+        hdr.names_size += pe->toc.name_length;
+        ok = fwrite(&pe->toc, sizeof(pe->toc), 1, f) == 1;
+    }
+    unsigned int num_buckets = 1u << hdr.bucket_bits;
+    for (unsigned int b = 0, i = 0; b <= num_buckets && ok; ++b)
+    {
+        while (i < num_entries && (entries[i].hash >> (64 - hdr.bucket_bits)) < b)
+            ++i;
+        ok = fwrite(&i, sizeof(i), 1, f) == 1;
+    }
+    for (unsigned int i = 0; i < num_entries && ok; ++i)
+        ok = fwrite(entries[i].name, 1, entries[i].toc.name_length, f) == entries[i].toc.name_length;
+
+    /* Header last, it holds the table's location */
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Could not write %s\n", filename);
+        remove(filename);
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    int compress = argc > 1 && strcmp(argv[1], "-c") == 0;
+    int first = 1 + compress;
+    if (argc - first < 2)
+    {
+        fprintf(stderr, "Usage: %s [-c] <archive> <file>...\n", argv[0]);
+        return 1;
+    }
+    const char* archive = argv[first];
+    unsigned int num_entries = (unsigned int)(argc - first - 1);
+    struct pack_entry* entries = calloc(num_entries, sizeof(struct pack_entry));
+
+    int ok = 1;
+    for (unsigned int i = 0; i < num_entries && ok; ++i)
+        ok = pack_file(entries + i, argv[first + 1 + i], compress);
+    if (ok)
+    {
+        qsort(entries, num_entries, sizeof(struct pack_entry), compare_entries);
+        for (unsigned int i = 1; i < num_entries && ok; ++i)
+        {
+            if (strcmp(entries[i - 1].name, entries[i].name) == 0)
+            {
+                fprintf(stderr, "Duplicate path: %s\n", entries[i].name);
+                ok = 0;
+            }
+        }
+    }
+    ok = ok && write_archive(archive, entries, num_entries);
+
+    unsigned long long raw = 0, packed = 0;
+    for (unsigned int i = 0; i < num_entries; ++i)
+    {
+        raw += entries[i].toc.raw_size;
+        packed += entries[i].toc.size;
+        free(entries[i].blob);
+        close_asset(&entries[i].view);
+    }
+    free(entries);
+    if (ok)
+        printf("Packed %u files, %llu bytes into %llu\n", num_entries, raw, packed);
+    return ok ? 0 : 1;
+}